@@ -0,0 +1,122 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "gpmg/allocators.hpp"
+#include "gpmg/misc.hpp"
+
+using namespace std;
+using namespace gpmg;
+
+/// A malloc backed parent, tagged so that each run gets heaps of its own
+template <int tag>
+struct Parent {
+    void* allocate(size_t n) { return malloc(n); }
+    void deallocate(void* b) { free(b); }
+
+    unsigned int alignment = 16;
+};
+
+/// A phase of the workload, drawing most request sizes from one range and
+/// the rest from another
+struct Phase {
+    const char* name;
+    size_t minSize, maxSize;
+    size_t rareMinSize, rareMaxSize;
+    unsigned int rarePercent;
+};
+
+const size_t spanMemorySize = size_t(256) << 20;
+const size_t liveCount = 1 << 14;
+const size_t operationCount = 1 << 22;
+const size_t sizeLimit = 4096;
+
+const Phase phases[] = {{"small", 16, 200, 200, 1000, 5},
+                        {"medium", 500, 3000, 16, 200, 10},
+                        {"mixed", 16, 200, 2000, 4000, 1}};
+
+/// A request: the live slot to replace, and the size to replace it with
+struct Request {
+    size_t slot;
+    size_t size;
+};
+
+/// Draws the requests of a phase up front, so that only allocation is timed
+vector<Request> draw(const Phase& phase, mt19937_64& random) {
+    vector<Request> requests(operationCount);
+    for (Request& r : requests) {
+        const bool rare = random() % 100 < phase.rarePercent;
+        const size_t lo = rare ? phase.rareMinSize : phase.minSize;
+        const size_t hi = rare ? phase.rareMaxSize : phase.maxSize;
+        r.slot = random() % liveCount;
+        r.size = lo + random() % (hi - lo + 1);
+    }
+    return requests;
+}
+
+/// Replaces blocks of a live set following the requests of each phase in
+/// turn, timing every phase
+template <typename A>
+void run(const char* name, A& a, const vector<vector<Request>>& workload) {
+    vector<void*> live(liveCount, nullptr);
+
+    printf("%-12s", name);
+    for (size_t p = 0; p < workload.size(); ++p) {
+        auto start = chrono::steady_clock::now();
+        for (const Request& r : workload[p]) {
+            void*& slot = live[r.slot];
+            if (slot != nullptr) {
+                a.deallocate(slot);
+            }
+            slot = a.allocate(r.size);
+            if (slot == nullptr) {
+                printf("out of memory\n");
+                exit(1);
+            }
+        }
+        auto end = chrono::steady_clock::now();
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+        printf("  %s %6.1f ns/op", phases[p].name,
+               static_cast<double>(ns) / operationCount);
+    }
+    printf("\n");
+
+    for (void* b : live) {
+        if (b != nullptr) {
+            a.deallocate(b);
+        }
+    }
+}
+
+int main() {
+    mt19937_64 random(42);
+    vector<vector<Request>> workload;
+    for (const Phase& phase : phases) {
+        workload.push_back(draw(phase, random));
+    }
+
+    // Small requests are pooled by thread heaps, large ones take whole pages
+    // from a span allocator
+    void* fixedMemory = malloc(spanMemorySize);
+    memset(fixedMemory, 0, spanMemorySize);
+    auto fixed = SegregatorAllocator<256, ThreadHeapAllocator<Parent<0>>,
+                                     SpanAllocator<4096>>(
+        ThreadHeapAllocator<Parent<0>>(),
+        SpanAllocator<4096>(fixedMemory, spanMemorySize));
+    run("fixed", fixed, workload);
+
+    void* adaptiveMemory = malloc(spanMemorySize);
+    memset(adaptiveMemory, 0, spanMemorySize);
+    auto adaptive =
+        AdaptiveSegregatorAllocator<ThreadHeapAllocator<Parent<1>>,
+                                    SpanAllocator<4096>, sizeLimit>(
+            ThreadHeapAllocator<Parent<1>>(),
+            SpanAllocator<4096>(adaptiveMemory, spanMemorySize), 256);
+    run("adaptive", adaptive, workload);
+
+    free(adaptiveMemory);
+    free(fixedMemory);
+    return 0;
+}
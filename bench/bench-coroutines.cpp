@@ -0,0 +1,124 @@
+#include <chrono>
+#include <coroutine>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include "gpmg/allocators.hpp"
+#include "gpmg/coroutines.hpp"
+#include "gpmg/misc.hpp"
+
+using namespace std;
+using namespace gpmg;
+
+/// Global frame allocation, the baseline being measured against
+struct DefaultAllocation {};
+
+/// A minimal lazily started coroutine, parameterised on its frame allocation
+template <typename Allocation>
+class Task {
+   public:
+    struct promise_type : Allocation {
+        Task get_return_object() {
+            return Task(coroutine_handle<promise_type>::from_promise(*this));
+        }
+        static Task get_return_object_on_allocation_failure() {
+            return Task(nullptr);
+        }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_always final_suspend() noexcept { return {}; }
+        void return_value(int v) { value = v; }
+        void unhandled_exception() { abort(); }
+
+        int value = 0;
+    };
+
+    explicit Task(coroutine_handle<promise_type> h) : handle_(h) {}
+    Task(const Task&) = delete;
+    Task(Task&& other) : handle_(other.handle_) { other.handle_ = nullptr; }
+    Task& operator=(const Task&) = delete;
+    Task& operator=(Task&&) = delete;
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    int run() {
+        handle_.resume();
+        return handle_.promise().value;
+    }
+
+   private:
+    coroutine_handle<promise_type> handle_;
+};
+
+typedef FreelistAllocator<MallocAllocator, 512> Freelist;
+
+/// Region allocator that is rewound once every frame in it is dead, standing
+/// in for a per-connection arena
+class ConnectionRegion {
+   public:
+    ConnectionRegion(void* b, unsigned int size)
+        : alignment(1), b_(b), size_(size), region_(b, size) {}
+
+    void* allocate(std::size_t n) { return region_.allocate(n); }
+    void deallocate(void* b) { UNUSED(b) }
+    void rewind() { region_ = RegionAllocator(b_, size_); }
+
+    unsigned int alignment;
+
+   private:
+    void* b_;
+    unsigned int size_;
+    RegionAllocator region_;
+};
+
+__attribute__((noinline)) Task<DefaultAllocation> defaultTask(int a) {
+    co_return a + 1;
+}
+
+__attribute__((noinline)) Task<AllocatorArgPromise<ConnectionRegion>>
+regionTask(allocator_arg_t, ConnectionRegion&, int a) {
+    co_return a + 1;
+}
+
+__attribute__((noinline)) Task<ThreadLocalAllocatorPromise<Freelist>>
+freelistTask(int a) {
+    co_return a + 1;
+}
+
+/// Times creating, running and destroying the given number of coroutines
+template <typename F>
+void measure(const char* name, const int count, F&& f) {
+    long sum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        sum += f(i);
+    }
+    auto end = chrono::steady_clock::now();
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    printf("%-24s %8.2f ns/coroutine (checksum %ld)\n", name,
+           static_cast<double>(ns) / count, sum);
+}
+
+int main(int argc, char* argv[]) {
+    const int count = argc > 1 ? atoi(argv[1]) : 10000000;
+    const unsigned int regionSize = 1 << 16;
+    auto regionMemory = malloc(regionSize);
+    auto region = ConnectionRegion(regionMemory, regionSize);
+
+    measure("operator new", count,
+            [](int i) { return defaultTask(i).run(); });
+    measure("region (allocator_arg)", count, [&region](int i) {
+        // Rewind the region periodically, as a connection closing would
+        if ((i & 255) == 0) {
+            region.rewind();
+        }
+        return regionTask(allocator_arg, region, i).run();
+    });
+    measure("thread local freelist", count,
+            [](int i) { return freelistTask(i).run(); });
+
+    free(regionMemory);
+    return 0;
+}
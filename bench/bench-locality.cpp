@@ -0,0 +1,97 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "gpmg/allocators.hpp"
+#include "gpmg/misc.hpp"
+
+using namespace std;
+using namespace gpmg;
+
+/// A linked list node filling a cache line
+struct Node {
+    Node* next;
+    size_t slot;  /// Index of the node in the table of all nodes
+    u64 payload[6];
+};
+
+/// A malloc backed parent, tagged so that each run gets heaps of its own
+template <int tag>
+struct Parent {
+    void* allocate(size_t n) { return malloc(n); }
+    void deallocate(void* b) { free(b); }
+
+    unsigned int alignment = 16;
+};
+
+/// Builds a list interleaved with as many unrelated blocks, frees those to
+/// leave holes throughout the heap, then churns the list and times walking it.
+/// With near set, every replacement node is allocated next to its predecessor
+/// in the list, otherwise wherever the heap sees fit.
+template <typename A>
+void run(const char* name, const bool near, const size_t nodeCount,
+         const size_t churnCount, const int walkCount) {
+    A a;
+    mt19937_64 random(42);
+    vector<Node*> nodes(nodeCount);
+    vector<void*> noise(nodeCount);
+
+    Node* head = nullptr;
+    for (size_t i = nodeCount; i-- != 0;) {
+        noise[i] = a.allocate(sizeof(Node));
+        Node* n = static_cast<Node*>(a.allocate(sizeof(Node)));
+        n->next = head;
+        n->slot = i;
+        n->payload[0] = i;
+        nodes[i] = head = n;
+    }
+    for (void* b : noise) {
+        a.deallocate(b);
+    }
+
+    // Replace random successors, which scatters the list unless the
+    // replacements are placed near their predecessors
+    for (size_t i = 0; i < churnCount; ++i) {
+        Node* prev = nodes[random() % nodeCount];
+        Node* old = prev->next;
+        if (old == nullptr) {
+            continue;
+        }
+
+        const Node copy = *old;
+        a.deallocate(old);
+        Node* n = static_cast<Node*>(
+            near ? a.allocateNear(sizeof(Node), prev) : a.allocate(sizeof(Node)));
+        *n = copy;
+        prev->next = n;
+        nodes[n->slot] = n;
+    }
+
+    u64 sum = 0;
+    size_t hops = 0;
+    auto start = chrono::steady_clock::now();
+    for (int w = 0; w < walkCount; ++w) {
+        for (Node* n = head; n != nullptr; n = n->next) {
+            sum += n->payload[0];
+            ++hops;
+        }
+    }
+    auto end = chrono::steady_clock::now();
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    printf("%-16s %8.2f ns/hop (checksum %llu)\n", name,
+           static_cast<double>(ns) / hops,
+           static_cast<unsigned long long>(sum));
+}
+
+int main(int argc, char* argv[]) {
+    const size_t nodeCount = argc > 1 ? atoi(argv[1]) : 1 << 20;
+    const size_t churnCount = nodeCount * 4;
+    const int walkCount = 10;
+
+    run<ThreadHeapAllocator<Parent<0>>>("allocate", false, nodeCount,
+                                        churnCount, walkCount);
+    run<ThreadHeapAllocator<Parent<1>>>("allocateNear", true, nodeCount,
+                                        churnCount, walkCount);
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <chrono>
+#include <cstdio>
+#include "gpmg/allocators.hpp"
+#include "gpmg/misc.hpp"
+
+using namespace std;
+using namespace gpmg;
+
+typedef FreelistAllocator<MallocAllocator, 64> Pool;
+
+const int iterationCount = 1 << 24;
+const int batchSize = 16;
+
+/// Times batches of allocations followed by their deallocations
+template <typename A>
+void run(const char* name, A& a) {
+    void* blocks[batchSize];
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterationCount; i += batchSize) {
+        for (int j = 0; j < batchSize; ++j) {
+            blocks[j] = a.allocate(48);
+        }
+        for (int j = 0; j < batchSize; ++j) {
+            a.deallocate(blocks[j]);
+        }
+    }
+    auto end = chrono::steady_clock::now();
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    printf("%-24s %6.2f ns/op\n", name,
+           static_cast<double>(ns) / iterationCount);
+}
+
+int main() {
+    Pool pool;
+    run("freelist", pool);
+
+    auto profiled = SamplingProfilerAllocator<Pool>(Pool());
+    run("profiled freelist", profiled);
+    printf("%zu live samples\n", profiled.samples().size());
+    return 0;
+}
@@ -10,7 +10,13 @@
 #include "allocators/basic-allocator.hpp"
 #include "allocators/region-allocator.hpp"
 #include "allocators/malloc-allocator.hpp"
+#include "allocators/freelist-allocator.hpp"
+#include "allocators/span-allocator.hpp"
+#include "allocators/thread-heap-allocator.hpp"
 #include "allocators/fallback-allocator.hpp"
+#include "allocators/segregator-allocator.hpp"
+#include "allocators/adaptive-segregator-allocator.hpp"
+#include "allocators/sampling-profiler-allocator.hpp"
 #include "allocators/tools.hpp"
 #include "allocators/utils.hpp"
 
@@ -0,0 +1,221 @@
+/// \file      adaptive-segregator-allocator.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines a composite allocator, containing a small and large
+/// allocator, segregating allocations using a threshold tuned at runtime from
+/// the request sizes it observes.
+
+#ifndef GPMG_ALLOCATORS_ADAPTIVE_SEGREGATOR_ALLOCATOR_HPP
+#define GPMG_ALLOCATORS_ADAPTIVE_SEGREGATOR_ALLOCATOR_HPP
+
+#include <type_traits>
+#include "segregator-base.hpp"
+#include "tools.hpp"
+#include "utils.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+
+namespace gpmg {
+
+/// An allocator that utilises both a small and a large allocator, like the
+/// SegregatorAllocator, but with a threshold that follows the traffic.
+///
+/// One in every sampleInterval requests has its size recorded in a histogram
+/// of power of two size classes. Once a window of samples has been gathered,
+/// the threshold is moved to the largest class taking at least one in
+/// poolShare of the samples, so that every class seeing real traffic is
+/// pooled by the small allocator, while rarely requested sizes above them are
+/// forwarded to the large allocator rather than each tying up pool memory of
+/// their own. Classes already pooled stay so while they keep half that share,
+/// which stops the threshold flapping on a class near the boundary.
+///
+/// As blocks allocated under an earlier threshold may lie on either side of
+/// the current one, deallocation is always routed by ownership, and the
+/// members routing existing blocks are only present when either allocator has
+/// an 'owns' member function.
+/// Not thread safe; a multi threaded program wants one instance per thread.
+/// \tparam S The small allocator type
+/// \tparam L The large allocator type
+/// \tparam smallLimit The largest size the small allocator is able to serve,
+/// which bounds the threshold. Must be a power of two.
+template <typename S, typename L, std::size_t smallLimit>
+class AdaptiveSegregatorAllocator : private SegregatorBase<S, L> {
+   public:
+    ALLOCATOR_WELLFORMED(S)
+    ALLOCATOR_WELLFORMED(L)
+    static_assert(smallLimit != 0 && (smallLimit & (smallLimit - 1)) == 0,
+                  "The small allocator limit must be a power of two!");
+
+    /// \param small The small allocator
+    /// \param large The large allocator
+    /// \param threshold The threshold to start out with
+    /// \param sampleInterval The number of requests per sampled request
+    /// \param window The number of samples between threshold updates
+    /// \param poolShare The inverse of the share of samples a size class
+    /// needs to be pooled
+    AdaptiveSegregatorAllocator(const S& small, const L& large,
+                                const std::size_t threshold = smallLimit,
+                                const unsigned int sampleInterval = 64,
+                                const unsigned int window = 1024,
+                                const unsigned int poolShare = 32)
+        : SegregatorBase<S, L>(small, large),
+          alignment(min(small.alignment, large.alignment)),
+          threshold_(threshold),
+          countdown_(sampleInterval),
+          sampleInterval_(sampleInterval),
+          samples_(0),
+          window_(window),
+          poolShare_(poolShare),
+          histogram_() {
+        GPMG_ASSERT(threshold <= smallLimit,
+                    "Threshold must not exceed the small allocator limit!");
+        GPMG_ASSERT(sampleInterval != 0 && window != 0 && poolShare != 0,
+                    "Sampling parameters must be non zero!");
+    }
+    ~AdaptiveSegregatorAllocator() = default;
+    AdaptiveSegregatorAllocator(const AdaptiveSegregatorAllocator&) = default;
+    AdaptiveSegregatorAllocator(AdaptiveSegregatorAllocator&&) = default;
+    AdaptiveSegregatorAllocator& operator=(const AdaptiveSegregatorAllocator&) =
+        default;
+    AdaptiveSegregatorAllocator& operator=(AdaptiveSegregatorAllocator&&) =
+        default;
+
+    /// Allocates a block of memory of a given size
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocate(const std::size_t n) {
+        if (UNLIKELY(--countdown_ == 0)) {
+            sample(n);
+        }
+        return this->routedAllocate(n, n <= threshold_);
+    }
+
+    /// As SegregatorAllocator::allocateZeroed, under the current threshold
+    void* allocateZeroed(const std::size_t n) {
+        if (UNLIKELY(--countdown_ == 0)) {
+            sample(n);
+        }
+        return this->routedAllocateZeroed(n, n <= threshold_);
+    }
+
+    /// As SegregatorAllocator::allocateNear, under the current threshold
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value ||
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    void* allocateNear(const std::size_t n, void* hint) {
+        if (UNLIKELY(--countdown_ == 0)) {
+            sample(n);
+        }
+        return this->routedAllocateNear(n, hint, n <= threshold_);
+    }
+
+    /// Expands a block of memory of a given size to a new size. Blocks stay
+    /// with the allocator they came from, so a small block may grow up to the
+    /// small allocator limit whatever the current threshold.
+    /// \param b Pointer to a block of memory (presumably) owned by this
+    /// allocator
+    /// \param oldSize The original memory block size
+    /// \param newSize The new memory block size to expand to
+    /// \return Whether the expansion succeeded or not
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value ||
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    bool expand(void* b, const std::size_t oldSize, const std::size_t newSize) {
+        if (this->ownedBySmall(b)) {
+            return newSize <= smallLimit &&
+                   tools::tryToExpand(this->small_, b, oldSize, newSize);
+        }
+        return tools::tryToExpand(this->large_, b, oldSize, newSize);
+    }
+
+    /// As SegregatorAllocator::deallocate
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value ||
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    void deallocate(void* b) {
+        this->routedDeallocate(b);
+    }
+
+    /// As SegregatorAllocator::reallocate, under the current threshold
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value ||
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    bool reallocate(void*& b, const std::size_t oldSize,
+                    const std::size_t newSize) {
+        return this->routedReallocate(b, oldSize, newSize,
+                                      newSize <= threshold_);
+    }
+
+    /// As SegregatorAllocator::owns
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value &&
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    bool owns(void* b) {
+        return this->routedOwns(b);
+    }
+
+    /// Returns the current threshold, at or below which requests are routed
+    /// to the small allocator
+    std::size_t threshold() const { return threshold_; }
+
+    unsigned int alignment;  /// The memory alignment the allocator should use
+
+   private:
+    /// The number of histogram buckets: one per power of two up to the small
+    /// allocator limit, and one for everything larger
+    static const unsigned int classCount_ = floorLog2(smallLimit) + 1;
+    static const unsigned int bucketCount_ = classCount_ + 1;
+
+    /// Records the size of a request, updating the threshold at the end of
+    /// every window
+    void sample(const std::size_t n) {
+        countdown_ = sampleInterval_;
+
+        unsigned int c = 0;
+        while (c < classCount_ && (std::size_t(1) << c) < n) {
+            ++c;
+        }
+        ++histogram_[c];
+
+        if (++samples_ == window_) {
+            retune();
+        }
+    }
+
+    /// Moves the threshold to the largest hot size class, and starts a new
+    /// window
+    void retune() {
+        std::size_t threshold = 0;
+        for (unsigned int c = 0; c < classCount_; ++c) {
+            const std::size_t size = std::size_t(1) << c;
+            const std::size_t share =
+                size <= threshold_ ? 2 * poolShare_ : poolShare_;
+            if (histogram_[c] * share >= samples_) {
+                threshold = size;
+            }
+            histogram_[c] = 0;
+        }
+        histogram_[classCount_] = 0;
+        threshold_ = threshold;
+        samples_ = 0;
+    }
+
+    std::size_t threshold_;        /// The current segregation threshold
+    unsigned int countdown_;       /// Requests left until the next sample
+    unsigned int sampleInterval_;  /// Requests per sampled request
+    unsigned int samples_;         /// Samples taken in the current window
+    unsigned int window_;          /// Samples between threshold updates
+    unsigned int poolShare_;       /// Inverse share needed to be pooled
+    u32 histogram_[bucketCount_];  /// Sampled requests per size class
+};
+}
+
+#endif
@@ -29,7 +29,7 @@ class FallbackAllocator {
     ALLOCATOR_WELLFORMED(F)
 
     FallbackAllocator(const P& primary, const F& fallback)
-        : alignment(min(primary_.alignment, fallback_.alignment)),
+        : alignment(min(primary.alignment, fallback.alignment)),
           primary_(primary),
           fallback_(fallback) {}
     ~FallbackAllocator() = default;
@@ -50,6 +50,41 @@ class FallbackAllocator {
         return r;
     }
 
+    /// Allocates a zeroed block of memory of a given size, leaving memory
+    /// either allocator knows to be zero uncleared
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocateZeroed(std::size_t n) {
+        auto r = tools::tryToAllocateZeroed<P>(primary_, n);
+        if (r == nullptr) {
+            r = tools::tryToAllocateZeroed<F>(fallback_, n);
+        }
+        return r;
+    }
+
+    /// Allocates a block of memory of a given size, close to the hint when the
+    /// allocator owning the hint is able to. Only present when the primary
+    /// allocator has an 'owns' member function.
+    /// \param n The size of memory to try to allocate
+    /// \param hint A block allocated by this allocator, or nullptr
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    template <typename Q = P, typename std::enable_if<
+                                  tools::hasMemberFunc_owns<Q>::value>::type* =
+                                  nullptr>
+    void* allocateNear(std::size_t n, void* hint) {
+        if (hint == nullptr) {
+            return allocate(n);
+        }
+        if (primary_.owns(hint)) {
+            void* r = tools::tryToAllocateNear<P>(primary_, n, hint);
+            return r != nullptr ? r : fallback_.allocate(n);
+        }
+        void* r = tools::tryToAllocateNear<F>(fallback_, n, hint);
+        return r != nullptr ? r : primary_.allocate(n);
+    }
+
     /// Deallocates the given memory block if possible. Requires that the
     /// primary allocator has an 'owns' member function, and either the primary
     /// or fallback allocator have a 'deallocate' member function.
@@ -73,11 +108,12 @@ class FallbackAllocator {
 
     /// Attempts to reallocate the given memory block. Requires the primary
     /// allocator to have an 'owns' member function
-    /// \param b A pointer to a chunk of memory
+    /// \param b A pointer to a chunk of memory. Updated to point at the new
+    /// block upon success.
     /// \param oldSize The size for the old memory block
     /// \param newSize The size for the newly reallocated memory block
     /// \return Whether the reallocation was sucessful or not
-    bool reallocate(void* b, const std::size_t oldSize,
+    bool reallocate(void*& b, const std::size_t oldSize,
                     const std::size_t newSize) {
         static_assert(
             tools::hasMemberFunc_owns<P>::value,
@@ -88,7 +124,8 @@ class FallbackAllocator {
         // to unregister this memory block with the allocator and return
         // reallocation success.
         if (newSize == 0) {
-            tools::tryToDeallocate<FallbackAllocator>(this, b);
+            deallocate(b);
+            b = nullptr;
             return true;
         }
 
@@ -106,7 +143,7 @@ class FallbackAllocator {
         // fails, attempt to move the the memory from the primary allocator to
         // the fallback with the new size allocated.
         if (primary_.owns(b)) {
-            if (primary_.reallocate(b, oldSize, newSize)) {
+            if (gpmg::reallocate(primary_, b, oldSize, newSize)) {
                 return true;
             }
 
@@ -116,7 +153,7 @@ class FallbackAllocator {
 
         // Try to reallocate with the fallback, as if the function reaches this
         // point, the fallback definitely owns
-        if (fallback_.reallocate(b, oldSize, newSize)) {
+        if (gpmg::reallocate(fallback_, b, oldSize, newSize)) {
             return true;
         }
 
@@ -0,0 +1,130 @@
+/// \file      freelist-allocator.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines an allocator that caches freed fixed size blocks from a
+/// parent allocator in an intrusive list.
+
+#ifndef GPMG_ALLOCATORS_FREELIST_ALLOCATOR_HPP
+#define GPMG_ALLOCATORS_FREELIST_ALLOCATOR_HPP
+
+#include <cstring>
+#include <type_traits>
+#include "tools.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+
+namespace gpmg {
+
+/// An allocator that hands out blocks of a single fixed size from its parent,
+/// keeping deallocated blocks in a singly linked list threaded through the
+/// blocks themselves for reuse. Requests larger than the block size fail, so
+/// it is intended to be composed with a Fallback or Segregator allocator.
+/// \tparam P The parent allocator type
+/// \tparam blockSize The size of every block handed out
+template <typename P, std::size_t blockSize>
+class FreelistAllocator {
+   public:
+    ALLOCATOR_WELLFORMED(P)
+    static_assert(blockSize >= sizeof(void*),
+                  "Freelist blocks must be able to hold a pointer!");
+
+    explicit FreelistAllocator(const P& parent = P())
+        : alignment(parent.alignment), parent_(parent), head_(nullptr) {}
+    ~FreelistAllocator() = default;
+    FreelistAllocator(const FreelistAllocator&) = default;
+    FreelistAllocator(FreelistAllocator&&) = default;
+    FreelistAllocator& operator=(const FreelistAllocator&) = default;
+    FreelistAllocator& operator=(FreelistAllocator&&) = default;
+
+    /// Allocates a block of memory of a given size
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocate(const std::size_t n) {
+        if (UNLIKELY(n > blockSize)) {
+            return nullptr;
+        }
+
+        // Pop a cached block if there is one, otherwise go to the parent
+        if (head_ != nullptr) {
+            Node* r = head_;
+            head_ = r->next;
+            return r;
+        }
+        return parent_.allocate(blockSize);
+    }
+
+    /// Allocates a zeroed block of memory of a given size. Cached blocks are
+    /// cleared, while new blocks are left to the parent, which may know them
+    /// to be zero already.
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocateZeroed(const std::size_t n) {
+        if (UNLIKELY(n > blockSize)) {
+            return nullptr;
+        }
+
+        if (head_ != nullptr) {
+            Node* r = head_;
+            head_ = r->next;
+            std::memset(r, 0, n);
+            return r;
+        }
+        return tools::tryToAllocateZeroed<P>(parent_, blockSize);
+    }
+
+    /// Deallocates the given memory block, caching it for reuse
+    /// \param b The memory block to deallocate
+    void deallocate(void* b) {
+        Node* node = static_cast<Node*>(b);
+        node->next = head_;
+        head_ = node;
+    }
+
+    /// Hands all cached blocks back to the parent allocator if it is able to
+    /// deallocate
+    void deallocateAll() {
+        while (head_ != nullptr) {
+            Node* next = head_->next;
+            tools::tryToDeallocate<P>(parent_, head_);
+            head_ = next;
+        }
+    }
+
+    /// Returns the size of the block that would really be handed out for a
+    /// request of the given size
+    /// \param n The requested size
+    /// \return The block size if the request fits, else the requested size
+    std::size_t goodSize(const std::size_t n) {
+        return n <= blockSize ? blockSize : n;
+    }
+
+    /// Tests whether this allocator instance owns the memory given. Only
+    /// present when the parent allocator has an 'owns' member function.
+    /// \param b Pointer to the block of memory which is being checked for
+    /// ownership
+    /// \return Whether the memory is owned by this allocator or not
+    template <typename Q = P, typename std::enable_if<
+                                  tools::hasMemberFunc_owns<Q>::value>::type* =
+                                  nullptr>
+    bool owns(void* b) {
+        return parent_.owns(b);
+    }
+
+    unsigned int alignment;  /// The memory alignment the allocator should use
+
+   private:
+    /// A cached block, reinterpreted as a list link
+    struct Node {
+        Node* next;
+    };
+
+    P parent_;    /// The allocator blocks are drawn from
+    Node* head_;  /// The most recently deallocated block
+};
+}
+
+#endif
@@ -30,10 +30,35 @@ class MallocAllocator {
     /// a nullptr if unsuccessful.
     void* allocate(std::size_t n) { return malloc(n); }
 
+    /// Allocates a zeroed block of memory of a given size with calloc, which
+    /// skips clearing memory freshly mapped from the system
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocateZeroed(std::size_t n) { return calloc(1, n); }
+
     /// Deallocates the given memory block if possible
     /// \param b The memory block to try to deallocate
     void deallocate(void* b) { free(b); }
 
+    /// Reallocates the given memory block with realloc, which may grow the
+    /// block in place or relocate it without an intermediate copy through us
+    /// \param b A pointer to a chunk of memory. Updated to point at the new
+    /// block upon success.
+    /// \param oldSize The size for the old memory block
+    /// \param newSize The size for the newly reallocated memory block
+    /// \return Whether the reallocation was sucessful or not
+    bool reallocate(void*& b, const std::size_t oldSize,
+                    const std::size_t newSize) {
+        UNUSED(oldSize)
+        void* r = realloc(b, newSize);
+        if (r == nullptr && newSize != 0) {
+            return false;
+        }
+        b = r;
+        return true;
+    }
+
     unsigned int alignment =
         1;  /// The memory alignment the allocator should use
 };
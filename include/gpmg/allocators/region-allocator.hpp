@@ -8,6 +8,7 @@
 #ifndef GPMG_ALLOCATORS_REGION_ALLOCATOR_HPP
 #define GPMG_ALLOCATORS_REGION_ALLOCATOR_HPP
 
+#include <cstring>
 #include <type_traits>
 #include "tools.hpp"
 #include "../misc/types.hpp"
@@ -19,10 +20,19 @@ namespace gpmg {
 /// An allocator that takes a fixed size buffer and allocates linearly into
 /// that.
 /// Allocation is merely a pointer addition. Can not deallocate piecewise.
+/// As memory past the current position has never been handed out, a region
+/// over a buffer known to be zero (e.g. fresh pages from the system) hands
+/// out zeroed blocks without clearing them.
 class RegionAllocator {
    public:
-    RegionAllocator(void* b, unsigned int size)
-        : beg_(static_cast<u8*>(b)), end_(beg_ + size), p_(beg_) {}
+    /// \param b The buffer to allocate from
+    /// \param size The size of the buffer
+    /// \param zeroed Whether the buffer is known to be filled with zeroes
+    RegionAllocator(void* b, unsigned int size, bool zeroed = false)
+        : beg_(static_cast<u8*>(b)),
+          end_(beg_ + size),
+          p_(beg_),
+          zeroed_(zeroed) {}
     ~RegionAllocator() = default;
     RegionAllocator(const RegionAllocator&) = default;
     RegionAllocator(RegionAllocator&&) = default;
@@ -47,6 +57,49 @@ class RegionAllocator {
         return result;
     }
 
+    /// Allocates a zeroed block of memory of a given size, only clearing it
+    /// when the buffer was not known to be zero
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocateZeroed(std::size_t n) {
+        void* r = allocate(n);
+        if (r != nullptr && !zeroed_) {
+            std::memset(r, 0, n);
+        }
+        return r;
+    }
+
+    /// Expands a block of memory in place. Only the most recently allocated
+    /// block can be expanded, as it is the only one bordering free space.
+    /// \param b Pointer to a block of memory owned by this allocator
+    /// \param oldSize The original memory block size
+    /// \param newSize The new memory block size to expand to
+    /// \return Whether the expansion succeeded or not
+    bool expand(void* b, const std::size_t oldSize, const std::size_t newSize) {
+        // Blocks that aren't at the top of the region have a neighbour in the
+        // way
+        if (static_cast<u8*>(b) + oldSize != p_ || newSize < oldSize) {
+            return false;
+        }
+
+        const std::size_t delta = newSize - oldSize;
+        if (static_cast<std::size_t>(end_ - p_) < delta) {
+            return false;
+        }
+
+        p_ += delta;
+        return true;
+    }
+
+    /// Returns the size of the block that would really be handed out for a
+    /// request of the given size
+    /// \param n The requested size
+    /// \return The requested size rounded up to the region's alignment
+    std::size_t goodSize(const std::size_t n) {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
     /// Tests whether this allocator instance owns the memory given
     /// \param b Pointer to the block of memory which is being checked for
     /// ownership
@@ -61,9 +114,10 @@ class RegionAllocator {
         1;  /// The memory alignment the allocator should use
 
    private:
-    u8* beg_;  /// Pointer to the beginning of the region
-    u8* end_;  /// Pointer to the end of the region
-    u8* p_;    /// Pointer to the current position in the region
+    u8* beg_;      /// Pointer to the beginning of the region
+    u8* end_;      /// Pointer to the end of the region
+    u8* p_;        /// Pointer to the current position in the region
+    bool zeroed_;  /// Whether memory past the current position is zero
 };
 }
 
@@ -0,0 +1,410 @@
+/// \file      sampling-profiler-allocator.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines an allocator wrapper that samples allocations and records
+/// their call stacks, keeping a profile of sampled blocks still alive.
+
+#ifndef GPMG_ALLOCATORS_SAMPLING_PROFILER_ALLOCATOR_HPP
+#define GPMG_ALLOCATORS_SAMPLING_PROFILER_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include "malloc-allocator.hpp"
+#include "tools.hpp"
+#include "utils.hpp"
+#include "../containers/hash-map.hpp"
+#include "../containers/vector.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define GPMG_PROFILER_HAS_BACKTRACE_ 1
+#endif
+
+namespace gpmg {
+
+/// An allocator that forwards to its parent and samples roughly one
+/// allocation per samplePeriod bytes allocated, so that large blocks are
+/// proportionally more likely to be seen. The gap to the next sample is drawn
+/// from an exponential distribution, which keeps the samples free of bias
+/// towards any allocation pattern, and counted down by the size of each
+/// request. Unsampled allocations therefore cost a subtraction and a branch.
+/// Deallocations cost a load and a branch while no sampled block is alive;
+/// otherwise they also hash the address into a small table of counters and
+/// load the counter, and only blocks whose counter is non zero are looked up
+/// in the table of samples.
+///
+/// Sampled blocks have their call stack captured (where the platform offers
+/// backtrace), starting from the function that called into the profiler, and
+/// are kept in a table until deallocated, so the table is a snapshot of which
+/// call sites hold sampled memory. It can be written out as plain text with
+/// estimated totals, or as a legacy heap profile that pprof reads (and
+/// unsamples) itself.
+///
+/// The table draws its storage from a separate bookkeeping allocator, which
+/// must not be this allocator. Not thread safe; a multi threaded program
+/// wants one instance per thread.
+/// \tparam P The parent allocator type
+/// \tparam T The bookkeeping allocator type
+template <typename P, typename T = MallocAllocator>
+class SamplingProfilerAllocator {
+   public:
+    ALLOCATOR_WELLFORMED(P)
+    ALLOCATOR_WELLFORMED(T)
+
+    static const unsigned int maxDepth = 32;  /// Frames kept per sample
+
+    /// A sampled live block
+    struct Sample {
+        std::size_t size;        /// The requested size
+        unsigned int depth;      /// The number of frames captured
+        void* frames[maxDepth];  /// Return addresses, innermost first
+    };
+
+    /// \param parent The allocator to forward to
+    /// \param samplePeriod The mean number of bytes allocated per sample
+    /// \param bookkeeping The allocator the table of samples is kept in
+    explicit SamplingProfilerAllocator(const P& parent = P(),
+                                       const std::size_t samplePeriod =
+                                           512 * 1024,
+                                       const T& bookkeeping = T())
+        : alignment(parent.alignment),
+          parent_(parent),
+          countdown_(0),
+          samplePeriod_(samplePeriod),
+          random_(0x9E3779B97F4A7C15ull),
+          bookkeeping_(bookkeeping),
+          samples_(bookkeeping),
+          filter_() {
+        GPMG_ASSERT(samplePeriod != 0, "Sample period must be non zero!");
+        countdown_ = nextInterval();
+    }
+    ~SamplingProfilerAllocator() = default;
+    SamplingProfilerAllocator(const SamplingProfilerAllocator&) = delete;
+    SamplingProfilerAllocator(SamplingProfilerAllocator&&) = default;
+    SamplingProfilerAllocator& operator=(const SamplingProfilerAllocator&) =
+        delete;
+    SamplingProfilerAllocator& operator=(SamplingProfilerAllocator&&) =
+        default;
+
+    /// Allocates a block of memory of a given size
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    FORCE_INLINE void* allocate(const std::size_t n) {
+        void* r = parent_.allocate(n);
+        if (UNLIKELY((countdown_ -= static_cast<std::int64_t>(n)) < 0)) {
+            record(r, n);
+        }
+        return r;
+    }
+
+    /// Allocates a zeroed block of memory of a given size
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    FORCE_INLINE void* allocateZeroed(const std::size_t n) {
+        void* r = tools::tryToAllocateZeroed<P>(parent_, n);
+        if (UNLIKELY((countdown_ -= static_cast<std::int64_t>(n)) < 0)) {
+            record(r, n);
+        }
+        return r;
+    }
+
+    /// Deallocates the given memory block, dropping it from the profile if it
+    /// was sampled
+    /// \param b The memory block to deallocate
+    void deallocate(void* b) {
+        if (UNLIKELY(maybeSampled(b))) {
+            forget(b);
+        }
+        tools::tryToDeallocate<P>(parent_, b);
+    }
+
+    /// Expands a block of memory of a given size to a new size, keeping the
+    /// size of a sampled block up to date
+    /// \param b Pointer to a block of memory owned by this allocator
+    /// \param oldSize The original memory block size
+    /// \param newSize The new memory block size to expand to
+    /// \return Whether the expansion succeeded or not
+    bool expand(void* b, const std::size_t oldSize, const std::size_t newSize) {
+        if (!tools::tryToExpand<P>(parent_, b, oldSize, newSize)) {
+            return false;
+        }
+        if (UNLIKELY(maybeSampled(b))) {
+            Sample* s = samples_.find(b);
+            if (s != nullptr) {
+                s->size = newSize;
+            }
+        }
+        return true;
+    }
+
+    /// Reallocates the given memory block through the parent. For profiling
+    /// the old block counts as deallocated and the new one as allocated.
+    /// \param b A pointer to a chunk of memory. Updated to point at the new
+    /// block upon success.
+    /// \param oldSize The size for the old memory block
+    /// \param newSize The size for the newly reallocated memory block
+    /// \return Whether the reallocation was sucessful or not
+    FORCE_INLINE bool reallocate(void*& b, const std::size_t oldSize,
+                                 const std::size_t newSize) {
+        void* old = b;
+        if (!gpmg::reallocate(parent_, b, oldSize, newSize)) {
+            return false;
+        }
+        if (UNLIKELY(old != nullptr && maybeSampled(old))) {
+            forget(old);
+        }
+        if (UNLIKELY((countdown_ -= static_cast<std::int64_t>(newSize)) < 0)) {
+            record(b, newSize);
+        }
+        return true;
+    }
+
+    /// Tests whether this allocator instance owns the memory given. Only
+    /// present when the parent allocator has an 'owns' member function.
+    /// \param b Pointer to the block of memory which is being checked for
+    /// ownership
+    /// \return Whether the memory is owned by this allocator or not
+    template <typename Q = P, typename std::enable_if<
+                                  tools::hasMemberFunc_owns<Q>::value>::type* =
+                                  nullptr>
+    bool owns(void* b) {
+        return parent_.owns(b);
+    }
+
+    /// Returns the sampled blocks still alive, keyed by address
+    const HashMap<void*, Sample, T>& samples() const { return samples_; }
+
+    /// Estimates how many bytes allocated with the given size one sample
+    /// stands for. A block of n bytes is sampled with probability
+    /// 1 - exp(-n / samplePeriod), so each sample is weighted by the inverse.
+    /// \param n The size of the sampled block
+    /// \return The estimated number of bytes
+    double estimatedBytes(const std::size_t n) const {
+        if (n == 0) {
+            return 0;
+        }
+        const double size = static_cast<double>(n);
+        return size / -std::expm1(-size / static_cast<double>(samplePeriod_));
+    }
+
+    /// Writes the sampled live blocks as plain text, grouped by call stack
+    /// and ordered by estimated bytes, largest first
+    /// \param out The file to write to
+    /// \return Whether the profile was written successfully or not
+    bool writeText(std::FILE* out) {
+        Vector<Site, T> sites(bookkeeping_);
+        if (!collectSites(sites)) {
+            return false;
+        }
+        std::sort(sites.begin(), sites.end(),
+                  [](const Site& a, const Site& b) {
+                      return a.estimatedBytes > b.estimatedBytes;
+                  });
+
+        double totalBytes = 0;
+        for (const Site& site : sites) {
+            totalBytes += site.estimatedBytes;
+        }
+        std::fprintf(out,
+                     "Live heap: %zu samples, ~%.0f bytes estimated "
+                     "(sample period %zu bytes)\n",
+                     samples_.size(), totalBytes, samplePeriod_);
+        for (const Site& site : sites) {
+            std::fprintf(out, "\n~%.0f bytes in ~%.0f blocks (%zu sampled)\n",
+                         site.estimatedBytes, site.estimatedCount, site.count);
+            for (unsigned int i = 0; i < site.sample->depth; ++i) {
+                std::fprintf(out, "    #%-2u %p\n", i, site.sample->frames[i]);
+            }
+        }
+        return std::ferror(out) == 0;
+    }
+
+    /// Writes the sampled live blocks in the legacy heap profile format read
+    /// by pprof, followed by the process's memory mappings (where available)
+    /// so that pprof can symbolise the stacks
+    /// \param out The file to write to
+    /// \return Whether the profile was written successfully or not
+    bool writePprof(std::FILE* out) {
+        Vector<Site, T> sites(bookkeeping_);
+        if (!collectSites(sites)) {
+            return false;
+        }
+
+        std::size_t totalCount = 0;
+        std::size_t totalBytes = 0;
+        for (const Site& site : sites) {
+            totalCount += site.count;
+            totalBytes += site.bytes;
+        }
+        std::fprintf(out, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+                     totalCount, totalBytes, totalCount, totalBytes,
+                     samplePeriod_);
+        for (const Site& site : sites) {
+            std::fprintf(out, "%zu: %zu [%zu: %zu] @", site.count, site.bytes,
+                         site.count, site.bytes);
+            for (unsigned int i = 0; i < site.sample->depth; ++i) {
+                std::fprintf(out, " %p", site.sample->frames[i]);
+            }
+            std::fprintf(out, "\n");
+        }
+
+        std::FILE* maps = std::fopen("/proc/self/maps", "r");
+        if (maps != nullptr) {
+            std::fprintf(out, "\nMAPPED_LIBRARIES:\n");
+            char buffer[4096];
+            std::size_t n;
+            while ((n = std::fread(buffer, 1, sizeof(buffer), maps)) != 0) {
+                std::fwrite(buffer, 1, n, out);
+            }
+            std::fclose(maps);
+        }
+        return std::ferror(out) == 0;
+    }
+
+    unsigned int alignment;  /// The memory alignment the allocator should use
+
+   private:
+    static const std::size_t filterSize_ = 4096;
+    /// Extra frames captured to make up for those of the profiler's own
+    static const unsigned int skippedFrames_ = 4;
+
+    /// The sampled blocks sharing one call stack
+    struct Site {
+        const Sample* sample;   /// One of the samples, for its stack
+        std::size_t count;      /// The number of samples
+        std::size_t bytes;      /// The sampled bytes
+        double estimatedCount;  /// The estimated number of blocks
+        double estimatedBytes;  /// The estimated number of bytes
+    };
+
+    /// Orders samples by call stack
+    static bool stackLess(const Sample* a, const Sample* b) {
+        if (a->depth != b->depth) {
+            return a->depth < b->depth;
+        }
+        return std::memcmp(a->frames, b->frames, a->depth * sizeof(void*)) < 0;
+    }
+
+    static bool stackEqual(const Sample* a, const Sample* b) {
+        return a->depth == b->depth &&
+               std::memcmp(a->frames, b->frames, a->depth * sizeof(void*)) == 0;
+    }
+
+    /// Returns the counter in the filter covering a block. A zero counter
+    /// means no sampled block maps to it, so the block is not in the table.
+    static std::size_t filterSlot(void* b) {
+        const std::uint64_t p = reinterpret_cast<std::uintptr_t>(b);
+        return static_cast<std::size_t>((p * 0x9E3779B97F4A7C15ull) >> 52);
+    }
+
+    /// Tests whether a block may be in the table of samples, skipping the
+    /// filter altogether while the table is empty
+    bool maybeSampled(void* b) const {
+        return !samples_.empty() && filter_[filterSlot(b)] != 0;
+    }
+
+    /// Draws the number of bytes until the next sample
+    std::int64_t nextInterval() {
+        // xorshift64*, mapped onto (0, 1]
+        random_ ^= random_ >> 12;
+        random_ ^= random_ << 25;
+        random_ ^= random_ >> 27;
+        const std::uint64_t x = random_ * 0x2545F4914F6CDD1Dull;
+        const double u = static_cast<double>((x >> 11) + 1) / 9007199254740992.0;
+        return static_cast<std::int64_t>(
+            std::ceil(-std::log(u) * static_cast<double>(samplePeriod_)));
+    }
+
+    /// Adds a block to the profile and starts counting down to the next
+    /// sample. The block is dropped if it or its entry failed to allocate.
+    /// Never inlined, while the members sampling through it always are, so
+    /// that the caller's frame directly follows this one on the captured
+    /// stack. Everything before the caller's frame is dropped, including any
+    /// frame a wrapper around backtrace adds (e.g. a sanitizer's).
+    NO_INLINE void record(void* b, const std::size_t n) {
+        countdown_ = nextInterval();
+        if (b == nullptr) {
+            return;
+        }
+
+        Sample s;
+        s.size = n;
+        s.depth = 0;
+#ifdef GPMG_PROFILER_HAS_BACKTRACE_
+        void* frames[maxDepth + skippedFrames_];
+        const int depth =
+            backtrace(frames, static_cast<int>(maxDepth + skippedFrames_));
+        void* caller = __builtin_return_address(0);
+        int first = 0;
+        while (first < depth && frames[first] != caller) {
+            ++first;
+        }
+        if (first == depth) {
+            first = depth > 1 ? 1 : 0;
+        }
+        s.depth = static_cast<unsigned int>(
+            min(depth - first, static_cast<int>(maxDepth)));
+        std::memcpy(s.frames, frames + first, s.depth * sizeof(void*));
+#endif
+        if (samples_.insert(b, s) != nullptr) {
+            ++filter_[filterSlot(b)];
+        }
+    }
+
+    /// Removes a block from the profile if it is in it
+    void forget(void* b) {
+        if (samples_.erase(b)) {
+            --filter_[filterSlot(b)];
+        }
+    }
+
+    /// Groups the samples by call stack
+    bool collectSites(Vector<Site, T>& sites) {
+        Vector<const Sample*, T> sorted(bookkeeping_);
+        if (!sorted.reserve(samples_.size())) {
+            return false;
+        }
+        for (const auto& entry : samples_) {
+            sorted.pushBack(&entry.value);
+        }
+        std::sort(sorted.begin(), sorted.end(), stackLess);
+
+        for (const Sample* s : sorted) {
+            if (sites.empty() || !stackEqual(sites.back().sample, s)) {
+                const Site site = {s, 0, 0, 0, 0};
+                if (!sites.pushBack(site)) {
+                    return false;
+                }
+            }
+            Site& site = sites.back();
+            const double bytes = estimatedBytes(s->size);
+            site.count += 1;
+            site.bytes += s->size;
+            site.estimatedBytes += bytes;
+            site.estimatedCount +=
+                s->size == 0 ? 1 : bytes / static_cast<double>(s->size);
+        }
+        return true;
+    }
+
+    P parent_;                           /// The allocator being profiled
+    std::int64_t countdown_;             /// Bytes left until the next sample
+    std::size_t samplePeriod_;           /// Mean bytes between samples
+    std::uint64_t random_;               /// State of the interval generator
+    T bookkeeping_;                      /// Allocator for dumping profiles
+    HashMap<void*, Sample, T> samples_;  /// Sampled live blocks
+    u16 filter_[filterSize_];            /// Sampled blocks per filter slot
+};
+}
+
+#endif
@@ -9,6 +9,7 @@
 #define GPMG_ALLOCATORS_SEGREGATOR_ALLOCATOR_HPP
 
 #include <type_traits>
+#include "segregator-base.hpp"
 #include "tools.hpp"
 #include "utils.hpp"
 #include "../misc/types.hpp"
@@ -25,15 +26,14 @@ namespace gpmg {
 /// \tparam S The small allocator type
 /// \tparam L The large allocator type
 template <std::size_t threshold, typename S, typename L>
-class SegregatorAllocator {
+class SegregatorAllocator : private SegregatorBase<S, L> {
    public:
     ALLOCATOR_WELLFORMED(S)
     ALLOCATOR_WELLFORMED(L)
 
     SegregatorAllocator(const S& small, const L& large)
-        : alignment(min(small_.alignment, large_.alignment)),
-          small_(small),
-          large_(large) {}
+        : SegregatorBase<S, L>(small, large),
+          alignment(min(small.alignment, large.alignment)) {}
     ~SegregatorAllocator() = default;
     SegregatorAllocator(const SegregatorAllocator&) = default;
     SegregatorAllocator(SegregatorAllocator&&) = default;
@@ -45,7 +45,31 @@ class SegregatorAllocator {
     /// \return A pointer to the newly allocated block if successful,
     /// a nullptr if unsuccessful.
     void* allocate(const std::size_t n) {
-        return n <= threshold ? small_.allocate(n) : large_.allocate(n);
+        return this->routedAllocate(n, n <= threshold);
+    }
+
+    /// Allocates a zeroed block of memory of a given size, leaving memory
+    /// the chosen allocator knows to be zero uncleared
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocateZeroed(const std::size_t n) {
+        return this->routedAllocateZeroed(n, n <= threshold);
+    }
+
+    /// Allocates a block of memory of a given size, close to the hint when it
+    /// belongs to the same side of the threshold and that allocator is able
+    /// to. Only present when either allocator has an 'owns' member function.
+    /// \param n The size of memory to try to allocate
+    /// \param hint A block allocated by this allocator, or nullptr
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value ||
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    void* allocateNear(const std::size_t n, void* hint) {
+        return this->routedAllocateNear(n, hint, n <= threshold);
     }
 
     /// Expands a block of memory of a given size to a new size.
@@ -55,29 +79,62 @@ class SegregatorAllocator {
     /// \param newSize The new memory block size to expand to
     /// \return Whether the expansion succeeded or not
     bool expand(void* b, const std::size_t oldSize, const std::size_t newSize) {
-        static_assert(tools::hasMemberFunc_deallocate<S>::value ||
-                          tools::hasMemberFunc_deallocate<L>::value,
-                      "Either small or large allocator must have a conforming "
-                      "expand member function!");
-
-        if (newSize <= threshold) {
-            // Old and new allocations handled by small allocator
-            return tools::tryToExpand(small_, b, oldSize, newSize);
-        }
-        if (newSize > threshold) {
-            // Old and new allocations handled by large allocator
-            return tools::tryToExpand(large_, b, oldSize, newSize);
+        if (oldSize <= threshold) {
+            // The block belongs to the small allocator, and can only grow in
+            // place whilst it stays on the small side of the threshold
+            return newSize <= threshold &&
+                   tools::tryToExpand(this->small_, b, oldSize, newSize);
         }
 
-        // Something went horribly wrong
-        return false;
+        // Old and new allocations handled by large allocator
+        return tools::tryToExpand(this->large_, b, oldSize, newSize);
     }
 
-    unsigned int alignment;  /// The memory alignment the allocator should use
+    /// Deallocates the given memory block if possible. Only present when
+    /// either the small or large allocator has an 'owns' member function,
+    /// which is used to route the block back to the allocator it came from
+    /// regardless of the size it was allocated with.
+    /// \param b The memory block to try to deallocate
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value ||
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    void deallocate(void* b) {
+        this->routedDeallocate(b);
+    }
 
-   private:
-    S small_;  /// The small allocator
-    L large_;  /// The large allocator
+    /// Attempts to reallocate the given memory block, moving it between the
+    /// small and large allocators when it crosses the threshold. Only present
+    /// when either allocator has an 'owns' member function.
+    /// \param b A pointer to a chunk of memory. Updated to point at the new
+    /// block upon success.
+    /// \param oldSize The size for the old memory block
+    /// \param newSize The size for the newly reallocated memory block
+    /// \return Whether the reallocation was sucessful or not
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value ||
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    bool reallocate(void*& b, const std::size_t oldSize,
+                    const std::size_t newSize) {
+        return this->routedReallocate(b, oldSize, newSize,
+                                      newSize <= threshold);
+    }
+
+    /// Tests whether this allocator instance owns the memory given. Only
+    /// present when both the small and large allocator have 'owns' defined.
+    /// \param b Pointer to the block of memory which is being checked for
+    /// ownership
+    /// \return Whether the memory is owned by this allocator or not
+    template <typename Q = S,
+              typename std::enable_if<tools::hasMemberFunc_owns<Q>::value &&
+                                      tools::hasMemberFunc_owns<L>::value>::
+                  type* = nullptr>
+    bool owns(void* b) {
+        return this->routedOwns(b);
+    }
+
+    unsigned int alignment;  /// The memory alignment the allocator should use
 };
 }
 
@@ -0,0 +1,131 @@
+/// \file      segregator-base.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines the routing shared by the composite allocators that
+/// segregate allocations between a small and a large allocator.
+
+#ifndef GPMG_ALLOCATORS_SEGREGATOR_BASE_HPP
+#define GPMG_ALLOCATORS_SEGREGATOR_BASE_HPP
+
+#include <type_traits>
+#include "tools.hpp"
+#include "utils.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+
+namespace gpmg {
+
+/// Holds the small and large allocators of a segregating allocator, and
+/// routes requests between them. New blocks go to whichever allocator the
+/// deriving allocator's policy picks for the requested size; existing blocks
+/// are routed back by ownership, so a policy is free to change over time.
+/// The deriving allocator declares the public interface itself, as the
+/// static introspection in tools.hpp does not see inherited members.
+/// \tparam S The small allocator type
+/// \tparam L The large allocator type
+template <typename S, typename L>
+class SegregatorBase {
+   protected:
+    SegregatorBase(const S& small, const L& large)
+        : small_(small), large_(large) {}
+
+    /// Allocates a block of memory from the small or large allocator
+    void* routedAllocate(const std::size_t n, const bool toSmall) {
+        return toSmall ? small_.allocate(n) : large_.allocate(n);
+    }
+
+    /// Allocates a zeroed block of memory from the small or large allocator,
+    /// leaving memory the chosen allocator knows to be zero uncleared
+    void* routedAllocateZeroed(const std::size_t n, const bool toSmall) {
+        return toSmall ? tools::tryToAllocateZeroed<S>(small_, n)
+                       : tools::tryToAllocateZeroed<L>(large_, n);
+    }
+
+    /// Allocates a block of memory from the small or large allocator, close
+    /// to the hint when it belongs to that allocator and that allocator is
+    /// able to. Requires that either allocator has an 'owns' member function.
+    void* routedAllocateNear(const std::size_t n, void* hint,
+                             const bool toSmall) {
+        if (hint == nullptr) {
+            return routedAllocate(n, toSmall);
+        }
+        if (toSmall) {
+            return ownedBySmall(hint)
+                       ? tools::tryToAllocateNear<S>(small_, n, hint)
+                       : small_.allocate(n);
+        }
+        return !ownedBySmall(hint)
+                   ? tools::tryToAllocateNear<L>(large_, n, hint)
+                   : large_.allocate(n);
+    }
+
+    /// Deallocates a block through the allocator it came from. Requires that
+    /// either allocator has an 'owns' member function.
+    void routedDeallocate(void* b) {
+        if (ownedBySmall(b)) {
+            tools::tryToDeallocate<S>(small_, b);
+        } else {
+            tools::tryToDeallocate<L>(large_, b);
+        }
+    }
+
+    /// Reallocates a block, moving it between the small and large allocators
+    /// when the new size is routed to the other one
+    bool routedReallocate(void*& b, const std::size_t oldSize,
+                          const std::size_t newSize, const bool toSmall) {
+        if (newSize == 0) {
+            routedDeallocate(b);
+            b = nullptr;
+            return true;
+        }
+        if (b == nullptr) {
+            b = routedAllocate(newSize, toSmall);
+            return b != nullptr;
+        }
+
+        if (ownedBySmall(b)) {
+            return toSmall ? gpmg::reallocate(small_, b, oldSize, newSize)
+                           : crossAllocatorMove(b, small_, large_, oldSize,
+                                                newSize);
+        }
+        return !toSmall
+                   ? gpmg::reallocate(large_, b, oldSize, newSize)
+                   : crossAllocatorMove(b, large_, small_, oldSize, newSize);
+    }
+
+    /// Tests whether either allocator owns the memory given. Requires both
+    /// the small and large allocator to have 'owns' defined.
+    bool routedOwns(void* b) {
+        static_assert(
+            tools::hasMemberFunc_owns<S>::value,
+            "Small allocator must have a conforming 'owns' member function!");
+        static_assert(
+            tools::hasMemberFunc_owns<L>::value,
+            "Large allocator must have a conforming 'owns' member function!");
+
+        return small_.owns(b) || large_.owns(b);
+    }
+
+    /// Tests whether a block came from the small allocator. Asks the large
+    /// allocator when it is able to answer, as large allocators can typically
+    /// do so with a cheap page lookup, and the small allocator otherwise.
+    bool ownedBySmall(void* b) {
+        static_assert(tools::hasMemberFunc_owns<S>::value ||
+                          tools::hasMemberFunc_owns<L>::value,
+                      "Either small or large allocator must have a conforming "
+                      "'owns' member function!");
+        return ownedBySmall(
+            b, std::integral_constant<bool,
+                                      tools::hasMemberFunc_owns<L>::value>());
+    }
+    bool ownedBySmall(void* b, std::true_type) { return !large_.owns(b); }
+    bool ownedBySmall(void* b, std::false_type) { return small_.owns(b); }
+
+    S small_;  /// The small allocator
+    L large_;  /// The large allocator
+};
+}
+
+#endif
@@ -0,0 +1,488 @@
+/// \file      span-allocator.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines a page span allocator for large objects, using best-fit
+/// search over a tree of free spans and coalescing on deallocation.
+
+#ifndef GPMG_ALLOCATORS_SPAN_ALLOCATOR_HPP
+#define GPMG_ALLOCATORS_SPAN_ALLOCATOR_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "tools.hpp"
+#include "utils.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+
+namespace gpmg {
+
+/// An allocator that takes a reserved memory block, splits it into pages, and
+/// hands out runs of whole pages (spans). Free spans are kept in a treap keyed
+/// by (length, first page) so allocation is an address ordered best-fit
+/// search. Every span records its length in its first page's entry of a page
+/// map and its first page in its last page's entry, so deallocation coalesces
+/// with both neighbours in constant time and blocks can grow in place into a
+/// free right neighbour. Ownership is a page map lookup.
+/// Every page also records whether it may hold non zero bytes, so zeroed
+/// allocations only clear the pages that were handed out before. Pages start
+/// out clean when the reserved block is known to be zero, and purging gives
+/// free pages back to the system, which also leaves them clean.
+/// All bookkeeping lives at the front of the reserved block, so copies of the
+/// allocator share the same spans.
+/// \tparam pageSize The size and alignment of a page (a power of two)
+template <std::size_t pageSize = 4096>
+class SpanAllocator {
+   public:
+    static_assert((pageSize & (pageSize - 1)) == 0,
+                  "Page size must be a power of two!");
+
+    /// \param b The block to allocate from
+    /// \param size The size of the block
+    /// \param zeroed Whether the block is known to be filled with zeroes
+    SpanAllocator(void* b, std::size_t size, bool zeroed = false)
+        : alignment(pageSize), arena_(static_cast<Arena*>(b)) {
+        GPMG_ASSERT(size >= sizeof(Arena),
+                    "Span allocator needs room for its bookkeeping!");
+
+        // Work out how many pages fit behind the bookkeeping, starting from
+        // an estimate that is at most a page or so too high
+        const std::uintptr_t beg = reinterpret_cast<std::uintptr_t>(b);
+        const std::uintptr_t end = beg + size;
+        std::size_t count =
+            min(size / pageSize, size / (pageSize + sizeof(Page)) + 1);
+        std::uintptr_t first = 0;
+        for (; count != 0; --count) {
+            first = alignUp(beg + sizeof(Arena) + count * sizeof(Page));
+            if (first + count * pageSize <= end) {
+                break;
+            }
+        }
+
+        arena_->pages = reinterpret_cast<u8*>(first);
+        arena_->pageCount = static_cast<u32>(count);
+        arena_->root = nil_;
+        for (std::size_t i = 0; i < count; ++i) {
+            meta()[i].dirty = !zeroed;
+        }
+        if (count != 0) {
+            setSpan(0, arena_->pageCount, free_);
+            insert(0);
+        }
+    }
+    ~SpanAllocator() = default;
+    SpanAllocator(const SpanAllocator&) = default;
+    SpanAllocator(SpanAllocator&&) = default;
+    SpanAllocator& operator=(const SpanAllocator&) = default;
+    SpanAllocator& operator=(SpanAllocator&&) = default;
+
+    /// Allocates a block of memory of a given size
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocate(const std::size_t n) {
+        const std::size_t want = pagesFor(n);
+        if (UNLIKELY(want == 0)) {
+            return nullptr;
+        }
+        const u32 s = bestFit(want);
+        if (s == nil_) {
+            return nullptr;
+        }
+
+        erase(s);
+        const u32 length = meta()[s].length;
+        const u32 used = static_cast<u32>(want);
+        if (length > used) {
+            setSpan(s + used, length - used, free_);
+            insert(s + used);
+        }
+        setSpan(s, used, used_);
+        return arena_->pages + static_cast<std::size_t>(s) * pageSize;
+    }
+
+    /// Allocates a zeroed block of memory of a given size, only clearing the
+    /// pages that may have been written to since they were last known zero
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocateZeroed(const std::size_t n) {
+        void* r = allocate(n);
+        if (r == nullptr) {
+            return nullptr;
+        }
+
+        // Clear runs of dirty pages with one call each
+        const u32 s = pageOf(r);
+        const u32 end = s + static_cast<u32>(pagesFor(n));
+        for (u32 i = s; i < end;) {
+            if (!meta()[i].dirty) {
+                ++i;
+                continue;
+            }
+            u32 j = i + 1;
+            while (j < end && meta()[j].dirty) {
+                ++j;
+            }
+            std::memset(arena_->pages + static_cast<std::size_t>(i) * pageSize,
+                        0, static_cast<std::size_t>(j - i) * pageSize);
+            i = j;
+        }
+        return r;
+    }
+
+    /// Allocates a block of memory of a given size, preferring the free spans
+    /// bordering the hint's span so that the block lands on the pages right
+    /// next to it
+    /// \param n The size of memory to try to allocate
+    /// \param hint A block allocated by this allocator, or nullptr
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocateNear(const std::size_t n, void* hint) {
+        const std::size_t want = pagesFor(n);
+        if (hint == nullptr || want == 0) {
+            return allocate(n);
+        }
+
+        const u32 h = pageOf(hint);
+        const u32 used = static_cast<u32>(want);
+
+        // Take the front of a free span directly after the hint's span
+        const u32 right = h + meta()[h].length;
+        if (right < arena_->pageCount && meta()[right].state == free_ &&
+            meta()[right].length >= want) {
+            erase(right);
+            const u32 length = meta()[right].length;
+            if (length > used) {
+                setSpan(right + used, length - used, free_);
+                insert(right + used);
+            }
+            setSpan(right, used, used_);
+            return arena_->pages + static_cast<std::size_t>(right) * pageSize;
+        }
+
+        // Otherwise take the back of a free span directly before it
+        if (h != 0) {
+            const u32 left = meta()[h - 1].start;
+            if (meta()[left].state == free_ && meta()[left].length >= want) {
+                erase(left);
+                const u32 length = meta()[left].length;
+                if (length > used) {
+                    setSpan(left, length - used, free_);
+                    insert(left);
+                }
+                const u32 s = left + length - used;
+                setSpan(s, used, used_);
+                return arena_->pages + static_cast<std::size_t>(s) * pageSize;
+            }
+        }
+
+        return allocate(n);
+    }
+
+    /// Deallocates the given memory block, coalescing it with any free
+    /// neighbouring spans
+    /// \param b The memory block to deallocate
+    void deallocate(void* b) {
+        u32 s = pageOf(b);
+        GPMG_ASSERT(meta()[s].state == used_,
+                    "Deallocating a block not allocated by this allocator!");
+        u32 length = meta()[s].length;
+
+        // Whatever the block's owner wrote stays behind in its pages
+        for (u32 i = s; i < s + length; ++i) {
+            meta()[i].dirty = true;
+        }
+
+        // Absorb the right neighbour if it is free
+        const u32 right = s + length;
+        if (right < arena_->pageCount && meta()[right].state == free_) {
+            erase(right);
+            length += meta()[right].length;
+            meta()[right].state = none_;
+        }
+
+        // Fold into the left neighbour if it is free
+        if (s != 0) {
+            const u32 left = meta()[s - 1].start;
+            if (meta()[left].state == free_) {
+                erase(left);
+                length += meta()[left].length;
+                meta()[s].state = none_;
+                s = left;
+            }
+        }
+
+        setSpan(s, length, free_);
+        insert(s);
+    }
+
+    /// Expands a block of memory in place by taking pages from a free right
+    /// neighbour
+    /// \param b Pointer to a block of memory owned by this allocator
+    /// \param oldSize The original memory block size
+    /// \param newSize The new memory block size to expand to
+    /// \return Whether the expansion succeeded or not
+    bool expand(void* b, const std::size_t oldSize, const std::size_t newSize) {
+        UNUSED(oldSize)
+        const u32 s = pageOf(b);
+        const std::size_t want = pagesFor(newSize);
+        const u32 length = meta()[s].length;
+        if (want <= length) {
+            return true;
+        }
+
+        const u32 right = s + length;
+        if (right >= arena_->pageCount || meta()[right].state != free_ ||
+            length + meta()[right].length < want) {
+            return false;
+        }
+
+        erase(right);
+        const u32 total = length + meta()[right].length;
+        const u32 used = static_cast<u32>(want);
+        meta()[right].state = none_;
+        if (total > used) {
+            setSpan(s + used, total - used, free_);
+            insert(s + used);
+        }
+        setSpan(s, used, used_);
+        return true;
+    }
+
+    /// Resizes a block of memory in place, either growing it into a free
+    /// right neighbour or giving its trailing pages back
+    /// \param b A pointer to a chunk of memory owned by this allocator
+    /// \param oldSize The size for the old memory block
+    /// \param newSize The size for the newly reallocated memory block
+    /// \return Whether the block could be resized in place or not
+    bool reallocate(void*& b, const std::size_t oldSize,
+                    const std::size_t newSize) {
+        const u32 s = pageOf(b);
+        const std::size_t want = pagesFor(newSize);
+        const u32 length = meta()[s].length;
+        if (want > length) {
+            return expand(b, oldSize, newSize);
+        }
+        if (want == 0 || want == length) {
+            return want != 0;
+        }
+
+        // Split off the tail as its own allocated span and free it, which
+        // takes care of coalescing it with the right neighbour
+        const u32 used = static_cast<u32>(want);
+        setSpan(s, used, used_);
+        setSpan(s + used, length - used, used_);
+        deallocate(arena_->pages +
+                   static_cast<std::size_t>(s + used) * pageSize);
+        return true;
+    }
+
+#ifdef __linux__
+    /// Gives the dirty pages of every free span back to the system, which
+    /// hands them back filled with zeroes when next touched. Only valid when
+    /// the reserved block is private anonymous memory, e.g. from mmap.
+    /// \return The number of bytes given back
+    std::size_t purge() {
+        const std::size_t systemPage =
+            static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        std::size_t purged = 0;
+        for (u32 s = 0; s < arena_->pageCount; s += meta()[s].length) {
+            if (meta()[s].state != free_) {
+                continue;
+            }
+
+            // Only whole system pages can be given back
+            const u32 end = s + meta()[s].length;
+            for (u32 i = s; i < end;) {
+                if (!meta()[i].dirty) {
+                    ++i;
+                    continue;
+                }
+                u32 j = i + 1;
+                while (j < end && meta()[j].dirty) {
+                    ++j;
+                }
+                const std::uintptr_t lo = alignUp(
+                    reinterpret_cast<std::uintptr_t>(arena_->pages) +
+                        static_cast<std::size_t>(i) * pageSize,
+                    systemPage);
+                const std::uintptr_t hi =
+                    (reinterpret_cast<std::uintptr_t>(arena_->pages) +
+                     static_cast<std::size_t>(j) * pageSize) &
+                    ~static_cast<std::uintptr_t>(systemPage - 1);
+                if (lo < hi &&
+                    madvise(reinterpret_cast<void*>(lo), hi - lo,
+                            MADV_DONTNEED) == 0) {
+                    for (u32 k = i; k < j; ++k) {
+                        const std::uintptr_t p =
+                            reinterpret_cast<std::uintptr_t>(arena_->pages) +
+                            static_cast<std::size_t>(k) * pageSize;
+                        if (p >= lo && p + pageSize <= hi) {
+                            meta()[k].dirty = false;
+                        }
+                    }
+                    purged += hi - lo;
+                }
+                i = j;
+            }
+        }
+        return purged;
+    }
+#endif
+
+    /// Returns the size of the block that would really be handed out for a
+    /// request of the given size
+    /// \param n The requested size
+    /// \return The requested size rounded up to a whole number of pages
+    std::size_t goodSize(const std::size_t n) {
+        return pagesFor(n) * pageSize;
+    }
+
+    /// Tests whether this allocator instance owns the memory given
+    /// \param b Pointer to the block of memory which is being checked for
+    /// ownership
+    /// \return Whether the memory is owned by this allocator or not
+    bool owns(void* b) {
+        const u8* p = static_cast<u8*>(b);
+        if (p < arena_->pages ||
+            p >= arena_->pages + arena_->pageCount * pageSize) {
+            return false;
+        }
+        return meta()[pageOf(b)].state == used_;
+    }
+
+    unsigned int alignment;  /// The memory alignment the allocator should use
+
+   private:
+    static const u32 nil_ = ~static_cast<u32>(0);
+    static const u8 none_ = 0;  /// Page is not the first page of a span
+    static const u8 free_ = 1;  /// Page begins a free span
+    static const u8 used_ = 2;  /// Page begins an allocated span
+
+    /// Page map entry. Apart from the dirty flag, only the first and last
+    /// page of a span are kept up to date.
+    struct Page {
+        u32 length;  /// Span length in pages (first page only)
+        u32 start;   /// First page of the span (first and last page)
+        u32 left;    /// Treap child with smaller keys (free spans only)
+        u32 right;   /// Treap child with larger keys (free spans only)
+        u8 state;    /// One of none_, free_ or used_
+        u8 dirty;    /// Whether the page may hold non zero bytes (every page)
+    };
+
+    /// Bookkeeping at the front of the reserved block, followed by the page
+    /// map
+    struct Arena {
+        u8* pages;      /// The first page
+        u32 pageCount;  /// The number of pages
+        u32 root;       /// Root of the free span treap
+    };
+
+    static std::uintptr_t alignUp(const std::uintptr_t p,
+                                  const std::size_t to = pageSize) {
+        return (p + to - 1) & ~static_cast<std::uintptr_t>(to - 1);
+    }
+
+    static std::size_t pagesFor(const std::size_t n) {
+        return (n + pageSize - 1) / pageSize;
+    }
+
+    Page* meta() { return reinterpret_cast<Page*>(arena_ + 1); }
+
+    u32 pageOf(void* b) {
+        GPMG_ASSERT(static_cast<u8*>(b) >= arena_->pages &&
+                        static_cast<u8*>(b) <
+                            arena_->pages + arena_->pageCount * pageSize,
+                    "Block does not lie within the span allocator's pages!");
+        return static_cast<u32>((static_cast<u8*>(b) - arena_->pages) /
+                                pageSize);
+    }
+
+    /// Writes the boundary tags of a span
+    void setSpan(const u32 s, const u32 length, const u8 state) {
+        meta()[s].length = length;
+        meta()[s].start = s;
+        meta()[s].state = state;
+        meta()[s + length - 1].start = s;
+    }
+
+    /// Orders free spans by length, then by address
+    bool less(const u32 a, const u32 b) {
+        return meta()[a].length != meta()[b].length
+                   ? meta()[a].length < meta()[b].length
+                   : a < b;
+    }
+
+    /// Heap priority of a treap node, a hash of its page index
+    static u32 priority(const u32 s) { return s * 2654435761u; }
+
+    /// Returns the first (lowest addressed) of the smallest free spans holding
+    /// at least the given number of pages
+    u32 bestFit(const std::size_t n) {
+        u32 best = nil_;
+        for (u32 t = arena_->root; t != nil_;) {
+            if (meta()[t].length >= n) {
+                best = t;
+                t = meta()[t].left;
+            } else {
+                t = meta()[t].right;
+            }
+        }
+        return best;
+    }
+
+    /// Splits a treap into nodes ordered before the given key and the rest
+    void split(const u32 t, const u32 key, u32& l, u32& r) {
+        if (t == nil_) {
+            l = r = nil_;
+        } else if (less(t, key)) {
+            split(meta()[t].right, key, meta()[t].right, r);
+            l = t;
+        } else {
+            split(meta()[t].left, key, l, meta()[t].left);
+            r = t;
+        }
+    }
+
+    /// Joins two treaps where every key of the first precedes the second
+    u32 merge(const u32 l, const u32 r) {
+        if (l == nil_ || r == nil_) {
+            return l == nil_ ? r : l;
+        }
+        if (priority(l) > priority(r)) {
+            meta()[l].right = merge(meta()[l].right, r);
+            return l;
+        }
+        meta()[r].left = merge(l, meta()[r].left);
+        return r;
+    }
+
+    /// Adds a free span to the treap
+    void insert(const u32 s) {
+        u32 l, r;
+        meta()[s].left = meta()[s].right = nil_;
+        split(arena_->root, s, l, r);
+        arena_->root = merge(merge(l, s), r);
+    }
+
+    /// Removes a free span from the treap
+    void erase(const u32 s) {
+        u32* link = &arena_->root;
+        while (*link != s) {
+            link = less(s, *link) ? &meta()[*link].left : &meta()[*link].right;
+        }
+        *link = merge(meta()[s].left, meta()[s].right);
+    }
+
+    Arena* arena_;  /// Bookkeeping, stored inside the reserved block
+};
+}
+
+#endif
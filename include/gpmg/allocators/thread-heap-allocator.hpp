@@ -0,0 +1,402 @@
+/// \file      thread-heap-allocator.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines a thread safe small object allocator with a heap per
+/// thread, where blocks freed by other threads are handed back to the owning
+/// heap through a lock-free queue.
+
+#ifndef GPMG_ALLOCATORS_THREAD_HEAP_ALLOCATOR_HPP
+#define GPMG_ALLOCATORS_THREAD_HEAP_ALLOCATOR_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include "malloc-allocator.hpp"
+#include "tools.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+
+namespace gpmg {
+
+/// A small object allocator giving every thread its own heap. Each heap carves
+/// blocks of power of two size classes out of segments drawn from the parent
+/// allocator. Segments are aligned to their size and start with a header
+/// naming the owning heap, so the owner of any block is found by masking its
+/// address. Every segment keeps its own free list, so allocation stays within
+/// one segment for as long as it can, and allocateNear can serve a request
+/// from the same segment as its hint. A block freed by its owning thread goes
+/// straight back onto its segment's free list; a block freed by any other
+/// thread is pushed onto the owning heap's lock-free multi-producer single-
+/// consumer stack, which the owner drains in one batch before it next bumps
+/// into untouched memory, so remotely freed blocks are reused first. The heap
+/// of an exited thread is adopted by the next new thread, along with any
+/// blocks freed to it in the meantime.
+/// Requests larger than an eighth of a segment fail, so it is intended to be
+/// composed with a Fallback or Segregator allocator. All instances of the same
+/// type share the same heaps, so the parent must be default constructible.
+/// Segments are kept for the lifetime of the process.
+/// \tparam P The parent allocator type segments are drawn from
+/// \tparam segmentSize The size and alignment of a segment (a power of two)
+template <typename P = MallocAllocator, std::size_t segmentSize = 1 << 16>
+class ThreadHeapAllocator {
+   public:
+    ALLOCATOR_WELLFORMED(P)
+    static_assert((segmentSize & (segmentSize - 1)) == 0 &&
+                      segmentSize >= 4096,
+                  "Segment size must be a power of two of at least 4KiB!");
+
+    ThreadHeapAllocator() = default;
+    ~ThreadHeapAllocator() = default;
+    ThreadHeapAllocator(const ThreadHeapAllocator&) = default;
+    ThreadHeapAllocator(ThreadHeapAllocator&&) = default;
+    ThreadHeapAllocator& operator=(const ThreadHeapAllocator&) = default;
+    ThreadHeapAllocator& operator=(ThreadHeapAllocator&&) = default;
+
+    /// Allocates a block of memory of a given size from the calling thread's
+    /// heap
+    /// \param n The size of memory to try to allocate
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocate(const std::size_t n) {
+        if (UNLIKELY(n > maxSize_)) {
+            return nullptr;
+        }
+
+        Heap* h = localHeap();
+        if (UNLIKELY(h == nullptr)) {
+            return nullptr;
+        }
+
+        const unsigned int c = classOf(n);
+        Segment* s = h->available[c];
+        if (LIKELY(s != nullptr && s->free != nullptr)) {
+            return pop(s);
+        }
+        return allocateSlow(h, c);
+    }
+
+    /// Allocates a block of memory of a given size, from the same segment as
+    /// the hint if it belongs to the calling thread's heap and has room
+    /// \param n The size of memory to try to allocate
+    /// \param hint A block previously allocated by this allocator, or nullptr
+    /// \return A pointer to the newly allocated block if successful,
+    /// a nullptr if unsuccessful.
+    void* allocateNear(const std::size_t n, void* hint) {
+        if (hint != nullptr && n <= maxSize_) {
+            Segment* s = segmentOf(hint);
+            if (s->owner == handle().heap && s->sizeClass == classOf(n)) {
+                if (s->free == nullptr) {
+                    drainRemote(s->owner);
+                }
+                if (s->free != nullptr) {
+                    return pop(s);
+                }
+                if (hasRoom(s)) {
+                    return bump(s);
+                }
+            }
+        }
+        return allocate(n);
+    }
+
+    /// Deallocates the given memory block, handing it back to the heap of the
+    /// thread that allocated it
+    /// \param b The memory block to deallocate
+    void deallocate(void* b) {
+        Segment* s = segmentOf(b);
+        Heap* h = s->owner;
+        Block* block = static_cast<Block*>(b);
+
+        if (h == handle().heap) {
+            push(h, s, block);
+            return;
+        }
+
+        // Another thread's block; push it onto the owner's remote stack
+        Block* head = h->remote.load(std::memory_order_relaxed);
+        do {
+            block->next = head;
+        } while (!h->remote.compare_exchange_weak(head, block,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+    }
+
+    /// Returns the size of the block that would really be handed out for a
+    /// request of the given size
+    /// \param n The requested size
+    /// \return The size of the size class serving the request
+    std::size_t goodSize(const std::size_t n) {
+        return n > maxSize_ ? n : minSize_ << classOf(n);
+    }
+
+    /// Tests whether this allocator instance owns the memory given, by asking
+    /// the parent allocator about the segment the block would lie in. Only
+    /// present when the parent allocator has an 'owns' member function, which
+    /// is called without locking so must be safe to call concurrently with
+    /// allocation (e.g. a range check), as deallocation is routed through it.
+    /// \param b Pointer to the block of memory which is being checked for
+    /// ownership
+    /// \return Whether the memory is owned by this allocator or not
+    template <typename Q = P, typename std::enable_if<
+                                  tools::hasMemberFunc_owns<Q>::value>::type* =
+                                  nullptr>
+    bool owns(void* b) {
+        return shared().parent.owns(segmentOf(b));
+    }
+
+    /// Returns the usable size of a block handed out by this allocator
+    /// \param b Pointer to a block of memory owned by this allocator
+    /// \return The size of the block's size class
+    std::size_t usableSize(void* b) {
+        return minSize_ << segmentOf(b)->sizeClass;
+    }
+
+    unsigned int alignment =
+        minSize_;  /// The memory alignment the allocator should use
+
+   private:
+    static const std::size_t minSize_ = 16;
+    static const std::size_t maxSize_ = segmentSize / 8;
+    static const unsigned int classCount_ = 14;
+    static const std::size_t headerSize_ = 64;
+
+    /// A free block, reinterpreted as a list link
+    struct Block {
+        Block* next;
+    };
+
+    struct Heap;
+
+    /// Header at the start of every segment. All blocks in a segment belong to
+    /// the same size class.
+    struct Segment {
+        Heap* owner;             /// The heap blocks are returned to
+        unsigned int sizeClass;  /// The size class of every block
+        bool listed;             /// Whether the segment is in its heap's list
+        Block* free;             /// Blocks freed back to the segment
+        Segment* next;           /// The next segment in its heap's list
+        u8* bump;                /// The next never allocated block
+        u8* end;                 /// The end of the segment
+    };
+
+    /// A thread's heap
+    struct Heap {
+        Heap() : remote(nullptr), available(), inUse(true), next(nullptr) {}
+
+        /// Blocks freed by other threads, waiting to be drained
+        alignas(64) std::atomic<Block*> remote;
+        /// Segments that may have room, per size class
+        Segment* available[classCount_];
+        std::atomic<bool> inUse;  /// Whether a thread owns the heap
+        Heap* next;               /// The next heap in the registry
+    };
+
+    /// State shared by every instance of the allocator
+    struct Shared {
+        Shared() : lock(), parent(), heaps(nullptr) {}
+
+        std::mutex lock;           /// Serialises calls into the parent
+        P parent;                  /// The allocator segments are drawn from
+        std::atomic<Heap*> heaps;  /// Every heap ever created
+    };
+
+    /// Releases a thread's heap for adoption when the thread exits
+    struct Handle {
+        Handle() : heap(nullptr) {}
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+        ~Handle() {
+            if (heap != nullptr) {
+                // Forget the heap first, so that any block freed later on in
+                // the thread's exit takes the remote path
+                Heap* h = heap;
+                heap = nullptr;
+                h->inUse.store(false, std::memory_order_release);
+            }
+        }
+
+        Heap* heap;
+    };
+
+    static_assert(maxSize_ <= minSize_ << (classCount_ - 1),
+                  "Too many size classes for the number of free lists!");
+
+    static Shared& shared() {
+        static Shared instance;
+        return instance;
+    }
+
+    static Handle& handle() {
+        thread_local Handle instance;
+        return instance;
+    }
+
+    static Segment* segmentOf(void* b) {
+        return reinterpret_cast<Segment*>(reinterpret_cast<std::uintptr_t>(b) &
+                                          ~(segmentSize - 1));
+    }
+
+    static unsigned int classOf(const std::size_t n) {
+        unsigned int c = 0;
+        while ((minSize_ << c) < n) {
+            ++c;
+        }
+        return c;
+    }
+
+    /// Returns the calling thread's heap, adopting an abandoned heap or
+    /// creating a new one on first use
+    Heap* localHeap() {
+        Handle& local = handle();
+        if (LIKELY(local.heap != nullptr)) {
+            return local.heap;
+        }
+
+        Shared& s = shared();
+        for (Heap* h = s.heaps.load(std::memory_order_acquire); h != nullptr;
+             h = h->next) {
+            bool expected = false;
+            if (!h->inUse.load(std::memory_order_relaxed) &&
+                h->inUse.compare_exchange_strong(expected, true,
+                                                 std::memory_order_acquire)) {
+                local.heap = h;
+                return h;
+            }
+        }
+
+        void* b;
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            b = s.parent.allocate(sizeof(Heap) + alignof(Heap));
+        }
+        if (b == nullptr) {
+            return nullptr;
+        }
+
+        const std::uintptr_t p = reinterpret_cast<std::uintptr_t>(b);
+        Heap* h = new (reinterpret_cast<void*>(
+            (p + alignof(Heap) - 1) & ~(alignof(Heap) - 1))) Heap;
+        h->next = s.heaps.load(std::memory_order_relaxed);
+        while (!s.heaps.compare_exchange_weak(h->next, h,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+        local.heap = h;
+        return h;
+    }
+
+    static bool hasRoom(const Segment* s) {
+        return static_cast<std::size_t>(s->end - s->bump) >=
+               minSize_ << s->sizeClass;
+    }
+
+    static void* pop(Segment* s) {
+        Block* r = s->free;
+        s->free = r->next;
+        return r;
+    }
+
+    static void* bump(Segment* s) {
+        void* r = s->bump;
+        s->bump += minSize_ << s->sizeClass;
+        return r;
+    }
+
+    /// Returns a block to its segment, putting the segment back in the
+    /// heap's list if it had dropped out
+    static void push(Heap* h, Segment* s, Block* b) {
+        b->next = s->free;
+        s->free = b;
+        if (!s->listed) {
+            s->listed = true;
+            s->next = h->available[s->sizeClass];
+            h->available[s->sizeClass] = s;
+        }
+    }
+
+    /// Takes the whole remote stack at once and sorts it back onto the
+    /// segments
+    static void drainRemote(Heap* h) {
+        if (h->remote.load(std::memory_order_relaxed) == nullptr) {
+            return;
+        }
+        Block* b = h->remote.exchange(nullptr, std::memory_order_acquire);
+        while (b != nullptr) {
+            Block* next = b->next;
+            push(h, segmentOf(b), b);
+            b = next;
+        }
+    }
+
+    /// Finds room in a size class whose first listed segment has no free
+    /// blocks. Blocks freed by other threads are taken back first, and freed
+    /// blocks in any listed segment are reused before untouched space is
+    /// bumped into; full segments are dropped from the list, and a new
+    /// segment is only drawn when no listed segment has room.
+    void* allocateSlow(Heap* h, const unsigned int c) {
+        drainRemote(h);
+
+        Segment** link = &h->available[c];
+        Segment* room = nullptr;
+        while (*link != nullptr) {
+            Segment* s = *link;
+            if (s->free != nullptr) {
+                // Move the segment to the front, so the fast path finds it
+                *link = s->next;
+                s->next = h->available[c];
+                h->available[c] = s;
+                return pop(s);
+            }
+            if (hasRoom(s)) {
+                room = room == nullptr ? s : room;
+                link = &s->next;
+            } else {
+                s->listed = false;
+                *link = s->next;
+            }
+        }
+        if (room != nullptr) {
+            return bump(room);
+        }
+
+        Segment* s = newSegment(h, c);
+        return s == nullptr ? nullptr : bump(s);
+    }
+
+    /// Draws a new segment for a size class from the parent allocator. When
+    /// the parent can not guarantee segment alignment, twice the segment size
+    /// is requested and the aligned segment within it used.
+    Segment* newSegment(Heap* h, const unsigned int c) {
+        const bool aligned = shared().parent.alignment >= segmentSize;
+        void* raw;
+        {
+            std::lock_guard<std::mutex> guard(shared().lock);
+            raw = shared().parent.allocate(aligned ? segmentSize
+                                                   : 2 * segmentSize);
+        }
+        if (raw == nullptr) {
+            return nullptr;
+        }
+
+        const std::uintptr_t p = reinterpret_cast<std::uintptr_t>(raw);
+        u8* base = reinterpret_cast<u8*>((p + segmentSize - 1) &
+                                         ~(segmentSize - 1));
+        Segment* s = new (base) Segment;
+        s->owner = h;
+        s->sizeClass = c;
+        s->bump = base + headerSize_;
+        s->end = base + segmentSize;
+        s->free = nullptr;
+        s->listed = true;
+        s->next = h->available[c];
+        h->available[c] = s;
+        return s;
+    }
+};
+}
+
+#endif
@@ -8,6 +8,9 @@
 #ifndef GPMG_ALLOCATORS_TOOLS_HPP
 #define GPMG_ALLOCATORS_TOOLS_HPP
 
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
 #include "../misc/types.hpp"
 #include "../misc/platform.hpp"
 #include "../misc/static-introspection.hpp"
@@ -19,26 +22,72 @@ GENERATE_HAS_MEMBER_FUNC(void*, allocate, std::size_t)
 GENERATE_HAS_MEMBER_VAR(unsigned int, alignment)
 GENERATE_HAS_MEMBER_FUNC(bool, owns, void*)
 GENERATE_HAS_MEMBER_FUNC(void, deallocate, void*)
-GENERATE_HAS_MEMBER_FUNC(bool, reallocate, void*, std::size_t, std::size_t)
+GENERATE_HAS_MEMBER_FUNC(void, deallocateAll, void)
+GENERATE_HAS_MEMBER_FUNC(bool, reallocate, void*&, std::size_t, std::size_t)
 GENERATE_HAS_MEMBER_FUNC(bool, expand, void*, std::size_t, std::size_t)
+GENERATE_HAS_MEMBER_FUNC(std::size_t, goodSize, std::size_t)
+GENERATE_HAS_MEMBER_FUNC(void*, allocateNear, std::size_t, void*)
+GENERATE_HAS_MEMBER_FUNC(void*, allocateZeroed, std::size_t)
 
 // The SFINAE functions that attempt to call member functions of an allocator
 /// Do nothing if the given allocator has no appropriate allocate method
 template <typename T, typename std::enable_if<
-                          !hasMemberFunc_deallocate<T>::value>::type* = nullptr>
+                          !hasMemberFunc_allocate<T>::value>::type* = nullptr>
 void* tryToAllocate(T& allocator, std::size_t size) {
     UNUSED(allocator);
     UNUSED(size);
     return nullptr;
 }
 
-/// Deallocate given buffer using the given allocator's allocate method
+/// Allocate a buffer of the given size using the given allocator's allocate
+/// method
 template <typename T, typename std::enable_if<
-                          hasMemberFunc_deallocate<T>::value>::type* = nullptr>
+                          hasMemberFunc_allocate<T>::value>::type* = nullptr>
 void* tryToAllocate(T& allocator, std::size_t size) {
     return allocator.allocate(size);
 }
 
+/// Allocate anywhere if the given allocator has no appropriate allocateNear
+/// method
+template <typename T, typename std::enable_if<
+                          !hasMemberFunc_allocateNear<T>::value>::type* =
+                          nullptr>
+void* tryToAllocateNear(T& allocator, std::size_t size, void* hint) {
+    UNUSED(hint);
+    return allocator.allocate(size);
+}
+
+/// Allocate a buffer close to the hint using the given allocator's
+/// allocateNear method
+template <typename T, typename std::enable_if<
+                          hasMemberFunc_allocateNear<T>::value>::type* =
+                          nullptr>
+void* tryToAllocateNear(T& allocator, std::size_t size, void* hint) {
+    return allocator.allocateNear(size, hint);
+}
+
+/// Allocate and clear a buffer if the given allocator has no appropriate
+/// allocateZeroed method
+template <typename T, typename std::enable_if<
+                          !hasMemberFunc_allocateZeroed<T>::value>::type* =
+                          nullptr>
+void* tryToAllocateZeroed(T& allocator, std::size_t size) {
+    void* r = allocator.allocate(size);
+    if (r != nullptr) {
+        std::memset(r, 0, size);
+    }
+    return r;
+}
+
+/// Allocate a zeroed buffer using the given allocator's allocateZeroed method,
+/// which only clears memory not already known to be zero
+template <typename T, typename std::enable_if<
+                          hasMemberFunc_allocateZeroed<T>::value>::type* =
+                          nullptr>
+void* tryToAllocateZeroed(T& allocator, std::size_t size) {
+    return allocator.allocateZeroed(size);
+}
+
 /// Do nothing if the given allocator has no appropriate deallocate method
 template <typename T, typename std::enable_if<
                           !hasMemberFunc_deallocate<T>::value>::type* = nullptr>
@@ -54,9 +103,26 @@ void tryToDeallocate(T& allocator, void* b) {
     allocator.deallocate(b);
 }
 
+/// Do nothing if the given allocator has no appropriate deallocateAll method
+template <typename T, typename std::enable_if<
+                          !hasMemberFunc_deallocateAll<T>::value>::type* =
+                          nullptr>
+void tryToDeallocateAll(T& allocator) {
+    UNUSED(allocator);
+}
+
+/// Deallocate everything the given allocator holds using its deallocateAll
+/// method
+template <typename T, typename std::enable_if<
+                          hasMemberFunc_deallocateAll<T>::value>::type* =
+                          nullptr>
+void tryToDeallocateAll(T& allocator) {
+    allocator.deallocateAll();
+}
+
 /// Do nothing if the given allocator has no appropriate expand method
 template <typename T, typename std::enable_if<
-                          !hasMemberFunc_deallocate<T>::value>::type* = nullptr>
+                          !hasMemberFunc_expand<T>::value>::type* = nullptr>
 bool tryToExpand(T& allocator, void* b, const std::size_t oldSize,
                  const std::size_t newSize) {
     UNUSED(allocator);
@@ -66,14 +132,49 @@ bool tryToExpand(T& allocator, void* b, const std::size_t oldSize,
     return false;
 }
 
-/// Expand given buffer using the given allocator's expand method
+/// Expand given buffer in place using the given allocator's expand method
 template <typename T, typename std::enable_if<
-                          hasMemberFunc_deallocate<T>::value>::type* = nullptr>
+                          hasMemberFunc_expand<T>::value>::type* = nullptr>
 bool tryToExpand(T& allocator, void* b, const std::size_t oldSize,
                  const std::size_t newSize) {
-    if (oldSize <= newSize && allocator.expand(b, newSize - oldSize)) {
-        return true;
-    }
+    return oldSize <= newSize && allocator.expand(b, oldSize, newSize);
+}
+
+/// Do nothing if the given allocator has no appropriate reallocate method
+template <typename T, typename std::enable_if<
+                          !hasMemberFunc_reallocate<T>::value>::type* = nullptr>
+bool tryToReallocate(T& allocator, void*& b, const std::size_t oldSize,
+                     const std::size_t newSize) {
+    UNUSED(allocator);
+    UNUSED(b);
+    UNUSED(oldSize);
+    UNUSED(newSize);
+    return false;
+}
+
+/// Reallocate given buffer using the given allocator's reallocate method
+template <typename T, typename std::enable_if<
+                          hasMemberFunc_reallocate<T>::value>::type* = nullptr>
+bool tryToReallocate(T& allocator, void*& b, const std::size_t oldSize,
+                     const std::size_t newSize) {
+    return allocator.reallocate(b, oldSize, newSize);
+}
+
+/// Return the requested size unchanged if the given allocator has no
+/// appropriate goodSize method
+template <typename T, typename std::enable_if<
+                          !hasMemberFunc_goodSize<T>::value>::type* = nullptr>
+std::size_t tryToGetGoodSize(T& allocator, const std::size_t n) {
+    UNUSED(allocator);
+    return n;
+}
+
+/// Round the requested size up to the size of the block the given allocator
+/// would actually hand out
+template <typename T, typename std::enable_if<
+                          hasMemberFunc_goodSize<T>::value>::type* = nullptr>
+std::size_t tryToGetGoodSize(T& allocator, const std::size_t n) {
+    return allocator.goodSize(n);
 }
 }
 }
@@ -7,11 +7,45 @@
 #ifndef GPMG_ALLOCATORS_UTILS_HPP
 #define GPMG_ALLOCATORS_UTILS_HPP
 
+#include <cstdint>
 #include <cstring>
 #include "tools.hpp"
 
 namespace gpmg {
 
+/// Returns the minimum of two given values
+/// \tparam T The type of the two value to be compared
+/// (should be numerical in some way)
+/// \param arg1 The first number
+/// \param arg2 The second number
+template <typename T>
+constexpr T min(const T arg1, const T arg2) {
+    return arg1 <= arg2 ? arg1 : arg2;
+}
+
+/// Returns the base two logarithm of a value, rounded down
+/// \param n The value, which should be non zero
+constexpr unsigned int floorLog2(const std::size_t n) {
+    return n <= 1 ? 0 : 1 + floorLog2(n >> 1);
+}
+
+/// Returns the extra bytes to request from an allocator so that the block it
+/// hands out can be aligned further
+/// \param guaranteed The alignment the allocator guarantees
+/// \param wanted The alignment needed (a power of two)
+constexpr std::size_t alignmentSlack(const unsigned int guaranteed,
+                                     const std::size_t wanted) {
+    return guaranteed >= wanted ? 0 : wanted - 1;
+}
+
+/// Returns the first address at or after the given one with an alignment
+/// \param p The address to align
+/// \param alignment The alignment needed (a power of two)
+inline void* alignPointer(void* p, const std::size_t alignment) {
+    const std::uintptr_t a = reinterpret_cast<std::uintptr_t>(p);
+    return reinterpret_cast<void*>((a + alignment - 1) & ~(alignment - 1));
+}
+
 /// A global allocate function for our generic allocators
 /// \tparam T The allocator type
 /// \param a An instance of the allocator
@@ -20,8 +54,34 @@ namespace gpmg {
 /// a nullptr if unsuccessful
 template <typename T>
 void* allocate(T& a, std::size_t size) {
-    // Deallocate old buffer if possible
-    return tools::tryToAllocate<T>(size);
+    return tools::tryToAllocate<T>(a, size);
+}
+
+/// A global allocate function for our generic allocators that places the new
+/// block close to a related one where the allocator supports it, so that
+/// objects traversed together share pages and cache lines
+/// \tparam T The allocator type
+/// \param a An instance of the allocator
+/// \param size Size of the block of memory to allocate
+/// \param hint A block allocated by the same allocator, or nullptr
+/// \return A pointer to the allocated block of memory if successful,
+/// a nullptr if unsuccessful
+template <typename T>
+void* allocateNear(T& a, std::size_t size, void* hint) {
+    return tools::tryToAllocateNear<T>(a, size, hint);
+}
+
+/// A global allocate function for our generic allocators that hands back a
+/// block filled with zeroes, leaving memory the allocator knows to be zero
+/// untouched where it supports it
+/// \tparam T The allocator type
+/// \param a An instance of the allocator
+/// \param size Size of the block of memory to allocate
+/// \return A pointer to the zeroed block of memory if successful,
+/// a nullptr if unsuccessful
+template <typename T>
+void* allocateZeroed(T& a, std::size_t size) {
+    return tools::tryToAllocateZeroed<T>(a, size);
 }
 
 /// A global deallocate function for our generic allocators
@@ -31,17 +91,21 @@ void* allocate(T& a, std::size_t size) {
 template <typename T>
 void deallocate(T& a, void* b) {
     // Deallocate old buffer if possible
-    tools::tryToDeallocate<T>(b);
+    tools::tryToDeallocate<T>(a, b);
 }
 
-/// A global reallocate function for our generic allocators
+/// A global reallocate function for our generic allocators. Prefers, in order,
+/// expanding in place, the allocator's own reallocate, and finally allocating
+/// a new block, copying the contents across and deallocating the old block.
 /// \tparam T The allocator type
 /// \param a An instance of the allocator
-/// \param b Pointer to a given block of memory to reallocate
+/// \param b Pointer to a given block of memory to reallocate. Updated to point
+/// at the new block upon success.
 /// \param oldSize The size of the old block of memory
 /// \param newSize The size of the new block of memory
+/// \return Whether the reallocation was successful or not
 template <typename T>
-bool reallocate(T& a, void* b, const std::size_t oldSize,
+bool reallocate(T& a, void*& b, const std::size_t oldSize,
                 const std::size_t newSize) {
     // Break out successfully if the buffer hasn't changed size
     if (oldSize == newSize) {
@@ -54,14 +118,22 @@ bool reallocate(T& a, void* b, const std::size_t oldSize,
         return true;
     }
 
+    // Let the allocator relocate the buffer itself if it knows how to
+    if (tools::tryToReallocate<T>(a, b, oldSize, newSize)) {
+        return true;
+    }
+
     // Try to allocate more memory of the new size
     void* r = a.allocate(newSize);
     if (r == nullptr) {
         return false;
     }
 
-    // Deallocate old buffer if possible
-    tools::tryToDeallocate<T>(b);
+    // Copy the contents across and deallocate old buffer if possible
+    if (b != nullptr) {
+        std::memcpy(r, b, min(oldSize, newSize));
+        tools::tryToDeallocate<T>(a, b);
+    }
 
     b = r;
     return true;
@@ -70,13 +142,15 @@ bool reallocate(T& a, void* b, const std::size_t oldSize,
 /// Attempt to move a given buffer across primary and fallback allocators
 /// \tparam From The type of the allocator to move from
 /// \tparam To The type of the allocator to move to
-/// \param b Pointer to the block of memory to move
+/// \param b Pointer to the block of memory to move. Updated to point at the
+/// new block upon success.
 /// \param from The allocator to move from
 /// \param to The allocator to move to
 /// \param oldSize The size of the old block of memory
-/// \parama newSize The size of the new block of memory
+/// \param newSize The size of the new block of memory
+/// \return Whether the move was successful or not
 template <typename From, typename To>
-bool crossAllocatorMove(void* b, From& from, To& to, std::size_t oldSize,
+bool crossAllocatorMove(void*& b, From& from, To& to, std::size_t oldSize,
                         std::size_t newSize) {
     // Try to allocate memory at the destination
     void* dest = to.allocate(newSize);
@@ -86,25 +160,15 @@ bool crossAllocatorMove(void* b, From& from, To& to, std::size_t oldSize,
     }
 
     // Copy the buffer from 'from' to 'to'
-    memcpy(dest, b, newSize);
+    std::memcpy(dest, b, min(oldSize, newSize));
 
     // Try to deallocate the old buffer if possible
-    tools::tryToDeallocate<From>(b);
+    tools::tryToDeallocate<From>(from, b);
 
     // Set the input pointer to point at the newly allocated
     b = dest;
     return true;
 }
-
-/// Returns the minimum of two given values
-/// \tparam T The type of the two value to be compared
-/// (should be numerical in some way)
-/// \param arg1 The first number
-/// \param arg2 The second number
-template <typename T>
-constexpr T min(const T arg1, const T arg2) {
-    return arg1 <= arg2 ? arg1 : arg2;
-}
 }
 
 #endif
@@ -0,0 +1,14 @@
+/// \file      containers.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines various containers drawing their storage from our
+/// allocators.
+
+#ifndef GPMG_CONTAINERS_HPP
+#define GPMG_CONTAINERS_HPP
+
+#include "containers/vector.hpp"
+#include "containers/hash-map.hpp"
+
+#endif
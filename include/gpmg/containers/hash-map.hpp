@@ -0,0 +1,306 @@
+/// \file      hash-map.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines an open addressing hash map that draws its storage from
+/// one of our allocators.
+
+#ifndef GPMG_CONTAINERS_HASH_MAP_HPP
+#define GPMG_CONTAINERS_HASH_MAP_HPP
+
+#include <cstring>
+#include <functional>
+#include <utility>
+#include "vector.hpp"
+#include "../allocators/tools.hpp"
+#include "../allocators/utils.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+
+namespace gpmg {
+
+/// An open addressing (linear probing) hash map holding its own instance of an
+/// allocator. Entries are kept densely packed in a Vector, so they grow using
+/// the same expand/reallocate path, while the probe table only stores indices
+/// into that array. The probe table is rebuilt from the entries whenever it
+/// grows, so its old contents never need copying and it can always be expanded
+/// in place when the allocator allows. Like the entries, the probe table is
+/// aligned within its block when the allocator does not guarantee it.
+/// Hashes are scattered by a multiplication before their top bits pick a
+/// slot, as std::hash is the identity for integers and pointers in common
+/// standard libraries and aligned pointers would otherwise crowd onto a few
+/// slots.
+/// Operations that may allocate report failure through their return value.
+/// \tparam K The key type
+/// \tparam V The mapped value type
+/// \tparam A The allocator type
+/// \tparam H The hash function type
+template <typename K, typename V, typename A, typename H = std::hash<K>>
+class HashMap {
+   public:
+    ALLOCATOR_WELLFORMED(A)
+
+    /// A key and its mapped value
+    struct Entry {
+        Entry(const K& k, const V& v, std::size_t h)
+            : key(k), value(v), hash(h) {}
+        Entry(K&& k, V&& v, std::size_t h)
+            : key(std::move(k)), value(std::move(v)), hash(h) {}
+
+        K key;
+        V value;
+        std::size_t hash;  /// Cached mixed hash, used when rebuilding the table
+    };
+
+    typedef Entry* Iterator;
+    typedef const Entry* ConstIterator;
+
+    explicit HashMap(const A& allocator, const H& hasher = H())
+        : entries_(allocator),
+          hasher_(hasher),
+          slotBlock_(nullptr),
+          slots_(nullptr),
+          slotCount_(0),
+          shift_(0) {}
+    ~HashMap() { releaseSlots(); }
+    HashMap(const HashMap&) = delete;
+    HashMap(HashMap&& other)
+        : entries_(std::move(other.entries_)),
+          hasher_(std::move(other.hasher_)),
+          slotBlock_(other.slotBlock_),
+          slots_(other.slots_),
+          slotCount_(other.slotCount_),
+          shift_(other.shift_) {
+        other.slotBlock_ = nullptr;
+        other.slots_ = nullptr;
+        other.slotCount_ = 0;
+    }
+    HashMap& operator=(const HashMap&) = delete;
+    HashMap& operator=(HashMap&& other) {
+        if (this != &other) {
+            releaseSlots();
+            entries_ = std::move(other.entries_);
+            hasher_ = std::move(other.hasher_);
+            slotBlock_ = other.slotBlock_;
+            slots_ = other.slots_;
+            slotCount_ = other.slotCount_;
+            shift_ = other.shift_;
+            other.slotBlock_ = nullptr;
+            other.slots_ = nullptr;
+            other.slotCount_ = 0;
+        }
+        return *this;
+    }
+
+    /// Looks up the value mapped to a key
+    /// \param key The key to look for
+    /// \return A pointer to the mapped value, or a nullptr if the key is absent
+    V* find(const K& key) {
+        const std::size_t slot = findSlot(key, hashOf(key));
+        return slot == npos_ ? nullptr : &entries_[slots_[slot] - 1].value;
+    }
+    const V* find(const K& key) const {
+        return const_cast<HashMap*>(this)->find(key);
+    }
+
+    /// Tests whether a key is present
+    bool contains(const K& key) const { return find(key) != nullptr; }
+
+    /// Maps a key to a value, replacing any value already mapped to it
+    /// \param key The key to insert
+    /// \param value The value to map to the key
+    /// \return A pointer to the mapped value, or a nullptr if storage for the
+    /// new entry could not be allocated
+    template <typename KeyT, typename ValueT>
+    V* insert(KeyT&& key, ValueT&& value) {
+        const std::size_t h = hashOf(key);
+        const std::size_t found = findSlot(key, h);
+        if (found != npos_) {
+            V& existing = entries_[slots_[found] - 1].value;
+            existing = std::forward<ValueT>(value);
+            return &existing;
+        }
+
+        // Entries grow geometrically through emplaceBack, so only the probe
+        // table needs making room for here
+        if (!reserveSlots(entries_.size() + 1) ||
+            !entries_.emplaceBack(K(std::forward<KeyT>(key)),
+                                  V(std::forward<ValueT>(value)), h)) {
+            return nullptr;
+        }
+        slots_[freeSlot(h)] = entries_.size();
+        return &entries_.back().value;
+    }
+
+    /// Removes a key and its mapped value
+    /// \param key The key to remove
+    /// \return Whether the key was present or not
+    bool erase(const K& key) {
+        const std::size_t slot = findSlot(key, hashOf(key));
+        if (slot == npos_) {
+            return false;
+        }
+
+        // Keep the entries dense by moving the last entry into the hole
+        const std::size_t index = slots_[slot] - 1;
+        const std::size_t last = entries_.size() - 1;
+        if (index != last) {
+            slots_[slotOf(last)] = index + 1;
+            entries_[index] = std::move(entries_[last]);
+        }
+        entries_.popBack();
+        removeSlot(slot);
+        return true;
+    }
+
+    /// Removes all entries, keeping the storage for reuse
+    void clear() {
+        entries_.clear();
+        if (slots_ != nullptr) {
+            std::memset(slots_, 0, slotCount_ * sizeof(std::size_t));
+        }
+    }
+
+    /// Ensures there is room for at least the given number of entries without
+    /// the probe table exceeding its maximum load
+    /// \param n The number of entries to make room for
+    /// \return Whether the storage could be grown or not
+    bool reserve(const std::size_t n) {
+        return entries_.reserve(n) && reserveSlots(n);
+    }
+
+    Iterator begin() { return entries_.begin(); }
+    Iterator end() { return entries_.end(); }
+    ConstIterator begin() const { return entries_.begin(); }
+    ConstIterator end() const { return entries_.end(); }
+
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+   private:
+    static const std::size_t npos_ = ~static_cast<std::size_t>(0);
+    static const std::size_t minSlots_ = 8;
+
+    std::size_t mask() const { return slotCount_ - 1; }
+
+    /// Hashes a key, scattering the hash over its top bits
+    std::size_t hashOf(const K& key) const {
+        return hasher_(key) * static_cast<std::size_t>(0x9E3779B97F4A7C15ull);
+    }
+
+    /// Returns the slot probing for a mixed hash starts from
+    std::size_t home(const std::size_t h) const { return h >> shift_; }
+
+    /// Doubles the probe table until it can index the given number of entries
+    /// without exceeding its maximum load
+    bool reserveSlots(const std::size_t n) {
+        std::size_t wanted = slotCount_ == 0 ? minSlots_ : slotCount_;
+        while (n * 4 > wanted * 3) {
+            wanted *= 2;
+        }
+        return wanted == slotCount_ || rehash(wanted);
+    }
+
+    /// Returns the probe table slot holding the given key, or npos_
+    std::size_t findSlot(const K& key, const std::size_t h) const {
+        if (slotCount_ == 0) {
+            return npos_;
+        }
+        for (std::size_t i = home(h);; i = (i + 1) & mask()) {
+            const std::size_t s = slots_[i];
+            if (s == 0) {
+                return npos_;
+            }
+            const Entry& e = entries_[s - 1];
+            if (e.hash == h && e.key == key) {
+                return i;
+            }
+        }
+    }
+
+    /// Returns the first empty probe table slot for the given hash
+    std::size_t freeSlot(const std::size_t h) const {
+        std::size_t i = home(h);
+        while (slots_[i] != 0) {
+            i = (i + 1) & mask();
+        }
+        return i;
+    }
+
+    /// Returns the probe table slot pointing at the given entry index
+    std::size_t slotOf(const std::size_t index) const {
+        std::size_t i = home(entries_[index].hash);
+        while (slots_[i] != index + 1) {
+            i = (i + 1) & mask();
+        }
+        return i;
+    }
+
+    /// Empties a probe table slot, shifting later members of the cluster back
+    /// so that no tombstones are needed
+    void removeSlot(std::size_t hole) {
+        slots_[hole] = 0;
+        for (std::size_t i = (hole + 1) & mask(); slots_[i] != 0;
+             i = (i + 1) & mask()) {
+            const std::size_t from = home(entries_[slots_[i] - 1].hash);
+            // Move the slot back if the hole lies cyclically within
+            // [from, i)
+            if (((i - from) & mask()) >= ((i - hole) & mask())) {
+                slots_[hole] = slots_[i];
+                slots_[i] = 0;
+                hole = i;
+            }
+        }
+    }
+
+    /// Grows the probe table to the given number of slots and rebuilds it
+    bool rehash(const std::size_t count) {
+        A& a = entries_.allocator();
+        const std::size_t slack =
+            alignmentSlack(a.alignment, alignof(std::size_t));
+        const std::size_t oldBytes = slotCount_ * sizeof(std::size_t) + slack;
+        const std::size_t newBytes = count * sizeof(std::size_t) + slack;
+
+        // The old table contents are discarded, so in place expansion is the
+        // only thing worth trying before getting a fresh block
+        if (slotBlock_ == nullptr ||
+            !tools::tryToExpand<A>(a, slotBlock_, oldBytes, newBytes)) {
+            void* b = a.allocate(newBytes);
+            if (b == nullptr) {
+                return false;
+            }
+            releaseSlots();
+            slotBlock_ = b;
+            slots_ = static_cast<std::size_t*>(
+                alignPointer(b, alignof(std::size_t)));
+        }
+
+        slotCount_ = count;
+        shift_ = sizeof(std::size_t) * 8 - floorLog2(count);
+        std::memset(slots_, 0, count * sizeof(std::size_t));
+        for (std::size_t i = 0; i < entries_.size(); ++i) {
+            slots_[freeSlot(entries_[i].hash)] = i + 1;
+        }
+        return true;
+    }
+
+    /// Hands the probe table back to the allocator
+    void releaseSlots() {
+        if (slotBlock_ != nullptr) {
+            tools::tryToDeallocate<A>(entries_.allocator(), slotBlock_);
+            slotBlock_ = nullptr;
+            slots_ = nullptr;
+        }
+    }
+
+    Vector<Entry, A> entries_;  /// Densely packed entries
+    H hasher_;                  /// The hash function
+    void* slotBlock_;           /// The block the probe table lies in
+    std::size_t* slots_;  /// Probe table of entry indices plus one, 0 if empty
+    std::size_t slotCount_;  /// The number of probe table slots (power of two)
+    unsigned int shift_;     /// Shift taking a mixed hash to its home slot
+};
+}
+
+#endif
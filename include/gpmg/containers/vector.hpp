@@ -0,0 +1,268 @@
+/// \file      vector.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines a growable array that draws its storage from one of our
+/// allocators.
+
+#ifndef GPMG_CONTAINERS_VECTOR_HPP
+#define GPMG_CONTAINERS_VECTOR_HPP
+
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "../allocators/tools.hpp"
+#include "../allocators/utils.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+
+namespace gpmg {
+
+/// A contiguous growable array holding its own instance of an allocator.
+/// Growth first tries to expand the current block in place, then lets the
+/// allocator relocate trivially copyable contents itself, and only falls back
+/// to allocating, moving and deallocating when neither is possible. Capacity
+/// is always sized to the block the allocator really hands out. Allocators
+/// guaranteeing less alignment than the elements need are asked for a little
+/// extra, and the elements placed at the first aligned address in the block.
+/// Operations that may allocate report failure through their return value.
+/// \tparam T The element type
+/// \tparam A The allocator type
+template <typename T, typename A>
+class Vector {
+   public:
+    ALLOCATOR_WELLFORMED(A)
+
+    typedef T* Iterator;
+    typedef const T* ConstIterator;
+
+    explicit Vector(const A& allocator)
+        : allocator_(allocator),
+          bytes_(0),
+          offset_(0),
+          data_(nullptr),
+          size_(0),
+          capacity_(0) {}
+    ~Vector() { release(); }
+    Vector(const Vector&) = delete;
+    Vector(Vector&& other)
+        : allocator_(std::move(other.allocator_)),
+          bytes_(other.bytes_),
+          offset_(other.offset_),
+          data_(other.data_),
+          size_(other.size_),
+          capacity_(other.capacity_) {
+        other.bytes_ = 0;
+        other.offset_ = 0;
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.capacity_ = 0;
+    }
+    Vector& operator=(const Vector&) = delete;
+    Vector& operator=(Vector&& other) {
+        if (this != &other) {
+            release();
+            allocator_ = std::move(other.allocator_);
+            bytes_ = other.bytes_;
+            offset_ = other.offset_;
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.bytes_ = 0;
+            other.offset_ = 0;
+            other.data_ = nullptr;
+            other.size_ = 0;
+            other.capacity_ = 0;
+        }
+        return *this;
+    }
+
+    /// Ensures there is room for at least the given number of elements
+    /// \param n The number of elements to make room for
+    /// \return Whether the storage could be grown or not
+    bool reserve(const std::size_t n) {
+        return n <= capacity_ || grow(n);
+    }
+
+    /// Constructs a new element in place at the end of the array
+    /// \param args The arguments to forward to the element's constructor
+    /// \return Whether the element could be added or not
+    template <typename... Args>
+    bool emplaceBack(Args&&... args) {
+        if (UNLIKELY(size_ == capacity_) &&
+            !grow(capacity_ == 0 ? 1 : capacity_ * 2)) {
+            return false;
+        }
+        new (data_ + size_) T(std::forward<Args>(args)...);
+        ++size_;
+        return true;
+    }
+
+    /// Copies an element onto the end of the array
+    /// \param value The element to copy
+    /// \return Whether the element could be added or not
+    bool pushBack(const T& value) { return emplaceBack(value); }
+
+    /// Moves an element onto the end of the array
+    /// \param value The element to move
+    /// \return Whether the element could be added or not
+    bool pushBack(T&& value) { return emplaceBack(std::move(value)); }
+
+    /// Destroys the last element of the array
+    void popBack() {
+        GPMG_ASSERT(size_ != 0, "Can not pop from an empty vector!");
+        --size_;
+        data_[size_].~T();
+    }
+
+    /// Resizes the array, value-initialising any new elements
+    /// \param n The new number of elements
+    /// \return Whether the storage could be grown or not
+    bool resize(const std::size_t n) {
+        if (!reserve(n)) {
+            return false;
+        }
+        while (size_ > n) {
+            popBack();
+        }
+        while (size_ < n) {
+            new (data_ + size_) T();
+            ++size_;
+        }
+        return true;
+    }
+
+    /// Destroys all elements, keeping the storage for reuse
+    void clear() {
+        while (size_ != 0) {
+            popBack();
+        }
+    }
+
+    T& operator[](const std::size_t i) {
+        GPMG_ASSERT(i < size_, "Vector index out of range!");
+        return data_[i];
+    }
+    const T& operator[](const std::size_t i) const {
+        GPMG_ASSERT(i < size_, "Vector index out of range!");
+        return data_[i];
+    }
+
+    T& back() { return (*this)[size_ - 1]; }
+    const T& back() const { return (*this)[size_ - 1]; }
+
+    Iterator begin() { return data_; }
+    Iterator end() { return data_ + size_; }
+    ConstIterator begin() const { return data_; }
+    ConstIterator end() const { return data_ + size_; }
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+
+    /// Returns the allocator the array draws its storage from
+    A& allocator() { return allocator_; }
+
+   private:
+    /// Destroys all elements and hands the storage back to the allocator
+    void release() {
+        clear();
+        if (data_ != nullptr) {
+            tools::tryToDeallocate<A>(allocator_, block());
+        }
+    }
+
+    /// Grows the storage to hold at least the given number of elements
+    /// \param n The number of elements to make room for
+    /// \return Whether the storage could be grown or not
+    bool grow(const std::size_t n) {
+        const std::size_t newBytes = tools::tryToGetGoodSize<A>(
+            allocator_,
+            n * sizeof(T) + alignmentSlack(allocator_.alignment, alignof(T)));
+
+        // Cheapest of all is when the block can simply be made bigger, which
+        // leaves the elements where they are
+        if (data_ != nullptr &&
+            tools::tryToExpand<A>(allocator_, block(), bytes_, newBytes)) {
+            adopt(block(), data_, newBytes);
+            return true;
+        }
+
+        // Trivially copyable elements can be relocated bytewise, so let the
+        // allocator do it if it can (e.g. realloc remapping pages). The new
+        // block may be aligned differently, shifting where the elements go.
+        if (std::is_trivially_copyable<T>::value && data_ != nullptr) {
+            void* b = block();
+            if (tools::tryToReallocate<A>(allocator_, b, bytes_, newBytes)) {
+                T* d = static_cast<T*>(alignPointer(b, alignof(T)));
+                u8* moved = static_cast<u8*>(b) + offset_;
+                if (size_ != 0 && reinterpret_cast<u8*>(d) != moved) {
+                    std::memmove(static_cast<void*>(d), moved,
+                                 size_ * sizeof(T));
+                }
+                adopt(b, d, newBytes);
+                return true;
+            }
+        }
+
+        void* b = allocator_.allocate(newBytes);
+        if (b == nullptr) {
+            return false;
+        }
+        T* d = static_cast<T*>(alignPointer(b, alignof(T)));
+        relocate(d);
+        if (data_ != nullptr) {
+            tools::tryToDeallocate<A>(allocator_, block());
+        }
+        adopt(b, d, newBytes);
+        return true;
+    }
+
+    /// Takes on a block holding the elements at the given address
+    void adopt(void* b, T* d, const std::size_t bytes) {
+        bytes_ = bytes;
+        offset_ = static_cast<std::size_t>(reinterpret_cast<u8*>(d) -
+                                           static_cast<u8*>(b));
+        data_ = d;
+        capacity_ = (bytes - offset_) / sizeof(T);
+    }
+
+    /// Returns the block handed out by the allocator
+    void* block() { return reinterpret_cast<u8*>(data_) - offset_; }
+
+    /// Moves the live elements into new storage bytewise
+    template <typename U = T, typename std::enable_if<
+                                  std::is_trivially_copyable<U>::value>::type* =
+                                  nullptr>
+    void relocate(T* dest) {
+        if (size_ != 0) {
+            std::memcpy(dest, data_, size_ * sizeof(T));
+        }
+    }
+
+    /// Move constructs the live elements into new storage, destroying the
+    /// originals
+    template <typename U = T, typename std::enable_if<
+                                  !std::is_trivially_copyable<U>::value>::type* =
+                                  nullptr>
+    void relocate(T* dest) {
+        for (std::size_t i = 0; i < size_; ++i) {
+            new (dest + i) T(std::move(data_[i]));
+            data_[i].~T();
+        }
+    }
+
+    A allocator_;           /// The allocator storage is drawn from
+    std::size_t bytes_;     /// The size of the block handed out
+    std::size_t offset_;    /// The offset of the elements within the block
+    T* data_;               /// Pointer to the first element, within the block
+    std::size_t size_;      /// The number of live elements
+    std::size_t capacity_;  /// The number of elements the storage can hold
+};
+}
+
+#endif
@@ -0,0 +1,13 @@
+/// \file      coroutines.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines various utilities for allocating coroutine frames from
+/// our allocators (requires C++20).
+
+#ifndef GPMG_COROUTINES_HPP
+#define GPMG_COROUTINES_HPP
+
+#include "coroutines/promise-allocation.hpp"
+
+#endif
@@ -0,0 +1,172 @@
+/// \file      promise-allocation.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines promise type mixins that allocate coroutine frames from
+/// our allocators (requires C++20).
+
+#ifndef GPMG_COROUTINES_PROMISE_ALLOCATION_HPP
+#define GPMG_COROUTINES_PROMISE_ALLOCATION_HPP
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include "../allocators/tools.hpp"
+#include "../misc/types.hpp"
+#include "../misc/platform.hpp"
+#include "../misc/assert.hpp"
+
+namespace gpmg {
+namespace detail {
+/// The alignment coroutine frames are given, matching global operator new
+constexpr std::size_t frameAlignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+/// Returns the offset at which bookkeeping is stored behind a coroutine frame
+/// of the given size
+constexpr std::size_t framePointerOffset(const std::size_t n) {
+    return (n + alignof(void*) - 1) / alignof(void*) * alignof(void*);
+}
+
+/// Returns the size of block to request for a frame of the given size with
+/// the given bytes of bookkeeping behind it, leaving slack to align the frame
+/// when the allocator does not already
+inline std::size_t frameBlockSize(const std::size_t n,
+                                  const std::size_t bookkeeping,
+                                  const unsigned int alignment) {
+    return framePointerOffset(n) + sizeof(void*) + bookkeeping +
+           (alignment >= frameAlignment ? 0 : frameAlignment - 1);
+}
+
+/// Places a frame of the given size at the first aligned address in the
+/// block, storing the block pointer behind it
+/// \return The frame, or nullptr if the block is nullptr
+inline void* placeFrame(void* b, const std::size_t n) {
+    if (b == nullptr) {
+        return nullptr;
+    }
+    const std::uintptr_t p = reinterpret_cast<std::uintptr_t>(b);
+    void* frame = reinterpret_cast<void*>((p + frameAlignment - 1) &
+                                          ~(frameAlignment - 1));
+    std::memcpy(static_cast<u8*>(frame) + framePointerOffset(n), &b,
+                sizeof(b));
+    return frame;
+}
+
+/// Returns the block a frame of the given size was placed in
+inline void* frameBlock(void* frame, const std::size_t n) {
+    void* b;
+    std::memcpy(&b, static_cast<u8*>(frame) + framePointerOffset(n),
+                sizeof(b));
+    return b;
+}
+
+/// Returns the address of the bookkeeping stored behind a frame of the given
+/// size, after the block pointer
+inline u8* frameBookkeeping(void* frame, const std::size_t n) {
+    return static_cast<u8*>(frame) + framePointerOffset(n) + sizeof(void*);
+}
+}
+
+/// A promise type mixin allocating coroutine frames from an allocator passed
+/// to the coroutine as its leading arguments, following the
+/// std::allocator_arg_t convention:
+///
+///     Task serve(std::allocator_arg_t, RegionAllocator& a, Socket s);
+///
+/// For member function coroutines the allocator follows the object argument.
+/// Frames are aligned to __STDCPP_DEFAULT_NEW_ALIGNMENT__, over allocating
+/// when the allocator's alignment falls short. A pointer to the allocator is
+/// stored behind the frame so that it can be handed back on destruction; the
+/// allocator must outlive the frame.
+/// The allocation functions are noexcept, so promises inheriting from this
+/// should define get_return_object_on_allocation_failure() to report failure.
+/// \tparam A The allocator type
+template <typename A>
+class AllocatorArgPromise {
+   public:
+    ALLOCATOR_WELLFORMED(A)
+
+    template <typename... Args>
+    static void* operator new(const std::size_t n, std::allocator_arg_t, A& a,
+                              const Args&...) noexcept {
+        return allocateFrame(a, n);
+    }
+
+    template <typename C, typename... Args>
+    static void* operator new(const std::size_t n, const C&,
+                              std::allocator_arg_t, A& a,
+                              const Args&...) noexcept {
+        return allocateFrame(a, n);
+    }
+
+    static void operator delete(void* frame, const std::size_t n) noexcept {
+        A* a;
+        std::memcpy(&a, detail::frameBookkeeping(frame, n), sizeof(a));
+        tools::tryToDeallocate<A>(*a, detail::frameBlock(frame, n));
+    }
+
+   private:
+    /// Allocates an aligned frame with room for the allocator pointer behind
+    /// it
+    static void* allocateFrame(A& a, const std::size_t n) {
+        void* frame = detail::placeFrame(
+            a.allocate(detail::frameBlockSize(n, sizeof(A*), a.alignment)), n);
+        if (frame != nullptr) {
+            A* p = &a;
+            std::memcpy(detail::frameBookkeeping(frame, n), &p, sizeof(p));
+        }
+        return frame;
+    }
+};
+
+/// A promise type mixin allocating every coroutine frame from a thread local
+/// instance of the allocator, so no allocator argument is required. Frames
+/// destroyed on another thread are handed to that thread's instance, which is
+/// only suitable for allocators that can take each other's blocks (e.g. a
+/// FreelistAllocator over a MallocAllocator). Frames are aligned as for
+/// AllocatorArgPromise. When a thread exits, its instance's deallocateAll is
+/// called if it has one, so blocks it caches (e.g. a FreelistAllocator's) are
+/// not leaked by pools that churn threads; frames must not be destroyed on a
+/// thread after its thread locals have been.
+/// The allocation functions are noexcept, so promises inheriting from this
+/// should define get_return_object_on_allocation_failure() to report failure.
+/// \tparam A The allocator type, which must be default constructible
+template <typename A>
+class ThreadLocalAllocatorPromise {
+   public:
+    ALLOCATOR_WELLFORMED(A)
+
+    static void* operator new(const std::size_t n) noexcept {
+        A& a = allocator();
+        return detail::placeFrame(
+            a.allocate(detail::frameBlockSize(n, 0, a.alignment)), n);
+    }
+
+    static void operator delete(void* frame, const std::size_t n) noexcept {
+        tools::tryToDeallocate<A>(allocator(), detail::frameBlock(frame, n));
+    }
+
+    /// Returns the calling thread's allocator instance
+    static A& allocator() {
+        thread_local Holder holder;
+        return holder.instance;
+    }
+
+   private:
+    /// Hands everything a thread's instance holds back when the thread exits
+    struct Holder {
+        Holder() : instance() {}
+        Holder(const Holder&) = delete;
+        Holder& operator=(const Holder&) = delete;
+        ~Holder() { tools::tryToDeallocateAll<A>(instance); }
+
+        A instance;
+    };
+};
+}
+
+#endif
+
+#endif
@@ -24,8 +24,11 @@
 #if defined(__GNUC__) || defined(__HP_aCC) || defined(__clang__)
 /// Forces the compiler to inline the tagged function/method
 #define FORCE_INLINE inline __attribute__((always_inline))
+/// Stops the compiler from inlining the tagged function/method
+#define NO_INLINE __attribute__((noinline))
 #else
 #define FORCE_INLINE __forceinline
+#define NO_INLINE __declspec(noinline)
 #endif
 
 #endif
@@ -0,0 +1,138 @@
+/// \file      preload-config.hpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines the composite allocator the malloc interposition library
+/// is built from. Point PRELOAD_CONFIG_DIR at a directory with another
+/// preload-config.hpp to try a different composite.
+
+#ifndef GPMG_PRELOAD_CONFIG_HPP
+#define GPMG_PRELOAD_CONFIG_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include "gpmg/allocators.hpp"
+
+extern "C" {
+void* __libc_malloc(std::size_t n);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void __libc_free(void* b);
+void* __libc_realloc(void* b, std::size_t n);
+void* __libc_memalign(std::size_t alignment, std::size_t n);
+}
+
+namespace gpmg {
+namespace preload {
+
+/// An allocator forwarding to the C library's own malloc, which stays
+/// reachable under its internal names once malloc itself is interposed
+class LibcAllocator {
+   public:
+    void* allocate(std::size_t n) { return __libc_malloc(n); }
+    void* allocateZeroed(std::size_t n) { return __libc_calloc(1, n); }
+    void deallocate(void* b) { __libc_free(b); }
+    bool reallocate(void*& b, const std::size_t oldSize,
+                    const std::size_t newSize) {
+        UNUSED(oldSize)
+        void* r = __libc_realloc(b, newSize);
+        if (r == nullptr && newSize != 0) {
+            return false;
+        }
+        b = r;
+        return true;
+    }
+
+    unsigned int alignment =
+        16;  /// The memory alignment the allocator should use
+};
+
+/// A lock-free bump allocator over one large lazily committed mapping, handing
+/// out segments for the thread heaps. Ownership is a range check, so any block
+/// not lying in the mapping (including anything allocated before or during
+/// bootstrap) is known to belong to the C library.
+class SegmentArena {
+   public:
+    static const std::size_t segmentSize = 1 << 16;
+    static const std::size_t reserveSize = std::size_t(64) << 30;
+
+    void* allocate(std::size_t n) {
+        State& s = state();
+        if (s.beg == nullptr) {
+            return nullptr;
+        }
+        n = (n + segmentSize - 1) & ~(segmentSize - 1);
+        const std::size_t offset = s.used.fetch_add(n);
+        return offset + n <= reserveSize ? s.beg + offset : nullptr;
+    }
+
+    bool owns(void* b) {
+        const State& s = state();
+        return static_cast<u8*>(b) >= s.beg &&
+               static_cast<u8*>(b) < s.beg + reserveSize;
+    }
+
+    unsigned int alignment =
+        segmentSize;  /// The memory alignment the allocator should use
+
+   private:
+    struct State {
+        State() : beg(nullptr), used(0) {
+            // Reserve a segment extra so the start can be aligned
+            void* p = mmap(nullptr, reserveSize + segmentSize,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (p != MAP_FAILED) {
+                const std::uintptr_t a = reinterpret_cast<std::uintptr_t>(p);
+                beg = reinterpret_cast<u8*>((a + segmentSize - 1) &
+                                            ~(segmentSize - 1));
+            }
+        }
+        State(const State&) = delete;
+        State& operator=(const State&) = delete;
+
+        u8* beg;
+        std::atomic<std::size_t> used;
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+};
+
+/// Small requests go to per-thread heaps, large ones to the C library
+typedef ThreadHeapAllocator<SegmentArena, SegmentArena::segmentSize> Small;
+typedef LibcAllocator Large;
+static const std::size_t threshold = SegmentArena::segmentSize / 8;
+typedef SegregatorAllocator<threshold, Small, Large> Composite;
+
+/// Allocates a block with an alignment beyond the composite's own. Size classes
+/// of the thread heaps are aligned to their size up to 64 bytes, so small
+/// requests are rounded up to a class of at least the alignment; anything else
+/// goes to the C library.
+inline void* allocateAligned(Composite& c, const std::size_t alignment,
+                             const std::size_t n) {
+    if (alignment <= 64 && n <= threshold) {
+        return c.allocate(n < alignment ? alignment : n);
+    }
+    return __libc_memalign(alignment, n);
+}
+
+/// Returns the usable size of a block handed out by the composite. The C
+/// library's malloc_usable_size has no internal name, so it is looked up past
+/// the interposing definition.
+inline std::size_t usableSize(void* b) {
+    if (Small().owns(b)) {
+        return Small().usableSize(b);
+    }
+    typedef std::size_t (*UsableSize)(void*);
+    static const UsableSize libcUsableSize = reinterpret_cast<UsableSize>(
+        dlsym(RTLD_NEXT, "malloc_usable_size"));
+    return libcUsableSize(b);
+}
+}
+}
+
+#endif
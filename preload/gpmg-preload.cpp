@@ -0,0 +1,196 @@
+/// \file      gpmg-preload.cpp
+/// \author    Hector Stalker
+/// \copyright Copyright 2015 Hector Stalker. All rights reserved.
+///            This project is released under the MIT License.
+/// \brief     Defines malloc and operator new replacements on top of a
+/// composite allocator, for use through LD_PRELOAD.
+///
+/// The composite is defined by preload-config.hpp, which must provide the
+/// type gpmg::preload::Composite along with allocateAligned and usableSize
+/// functions for it. Composite deallocation must route any block it did not
+/// hand out to the C library, as blocks allocated before the library was
+/// loaded, or while it was reentered, are freed through it too.
+
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+#include "preload-config.hpp"
+
+#define GPMG_PRELOAD_VISIBLE_ __attribute__((visibility("default")))
+#define GPMG_PRELOAD_EXPORT_ extern "C" GPMG_PRELOAD_VISIBLE_
+
+namespace {
+using gpmg::preload::Composite;
+
+/// Whether the calling thread is already inside the composite. Setting up a
+/// thread's heap can itself allocate (e.g. registering thread local
+/// destructors), and those requests are passed straight to the C library.
+__attribute__((tls_model("initial-exec"))) thread_local bool inside = false;
+
+/// Marks the calling thread as inside the composite for its lifetime
+class Reentrancy {
+   public:
+    Reentrancy() : entered_(!inside) { inside = true; }
+    ~Reentrancy() {
+        if (entered_) {
+            inside = false;
+        }
+    }
+    Reentrancy(const Reentrancy&) = delete;
+    Reentrancy& operator=(const Reentrancy&) = delete;
+
+    /// Whether this is the outermost call into the composite
+    bool entered() const { return entered_; }
+
+   private:
+    bool entered_;
+};
+
+Composite& composite() {
+    static Composite instance{gpmg::preload::Small(), gpmg::preload::Large()};
+    return instance;
+}
+
+void* allocate(const std::size_t n) {
+    Reentrancy guard;
+    void* r = guard.entered() ? composite().allocate(n == 0 ? 1 : n)
+                              : __libc_malloc(n);
+    if (UNLIKELY(r == nullptr)) {
+        errno = ENOMEM;
+    }
+    return r;
+}
+
+void* allocateZeroed(const std::size_t n) {
+    Reentrancy guard;
+    void* r = guard.entered() ? composite().allocateZeroed(n == 0 ? 1 : n)
+                              : __libc_calloc(1, n);
+    if (UNLIKELY(r == nullptr)) {
+        errno = ENOMEM;
+    }
+    return r;
+}
+
+void* allocateAligned(const std::size_t alignment, const std::size_t n) {
+    Reentrancy guard;
+    void* r = guard.entered()
+                  ? gpmg::preload::allocateAligned(composite(), alignment, n)
+                  : __libc_memalign(alignment, n);
+    if (UNLIKELY(r == nullptr)) {
+        errno = ENOMEM;
+    }
+    return r;
+}
+
+void deallocate(void* b) {
+    if (b != nullptr) {
+        Reentrancy guard;
+        composite().deallocate(b);
+    }
+}
+
+bool isPowerOfTwo(const std::size_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+void* newOrAbort(const std::size_t n) {
+    void* r = allocate(n);
+    if (UNLIKELY(r == nullptr)) {
+        // Built without exceptions, so std::bad_alloc can not be thrown
+        std::abort();
+    }
+    return r;
+}
+}
+
+GPMG_PRELOAD_EXPORT_ void* malloc(std::size_t n) { return allocate(n); }
+
+GPMG_PRELOAD_EXPORT_ void free(void* b) { deallocate(b); }
+
+GPMG_PRELOAD_EXPORT_ void* calloc(std::size_t count, std::size_t size) {
+    if (size != 0 && count > static_cast<std::size_t>(-1) / size) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return allocateZeroed(count * size);
+}
+
+GPMG_PRELOAD_EXPORT_ void* realloc(void* b, std::size_t n) {
+    if (b == nullptr) {
+        return allocate(n);
+    }
+    if (n == 0) {
+        deallocate(b);
+        return nullptr;
+    }
+
+    Reentrancy guard;
+    if (!composite().reallocate(b, gpmg::preload::usableSize(b), n)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return b;
+}
+
+GPMG_PRELOAD_EXPORT_ int posix_memalign(void** b, std::size_t alignment,
+                                        std::size_t n) {
+    if (!isPowerOfTwo(alignment) || alignment % sizeof(void*) != 0) {
+        return EINVAL;
+    }
+    void* r = allocateAligned(alignment, n);
+    if (r == nullptr) {
+        return ENOMEM;
+    }
+    *b = r;
+    return 0;
+}
+
+GPMG_PRELOAD_EXPORT_ void* aligned_alloc(std::size_t alignment,
+                                         std::size_t n) {
+    if (!isPowerOfTwo(alignment)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    return allocateAligned(alignment, n);
+}
+
+GPMG_PRELOAD_EXPORT_ void* memalign(std::size_t alignment, std::size_t n) {
+    return aligned_alloc(alignment, n);
+}
+
+GPMG_PRELOAD_EXPORT_ std::size_t malloc_usable_size(void* b) {
+    return b == nullptr ? 0 : gpmg::preload::usableSize(b);
+}
+
+GPMG_PRELOAD_VISIBLE_ void* operator new(std::size_t n) {
+    return newOrAbort(n);
+}
+GPMG_PRELOAD_VISIBLE_ void* operator new[](std::size_t n) {
+    return newOrAbort(n);
+}
+GPMG_PRELOAD_VISIBLE_ void* operator new(std::size_t n,
+                                         const std::nothrow_t&) noexcept {
+    return allocate(n);
+}
+GPMG_PRELOAD_VISIBLE_ void* operator new[](std::size_t n,
+                                           const std::nothrow_t&) noexcept {
+    return allocate(n);
+}
+GPMG_PRELOAD_VISIBLE_ void operator delete(void* b) noexcept {
+    deallocate(b);
+}
+GPMG_PRELOAD_VISIBLE_ void operator delete[](void* b) noexcept {
+    deallocate(b);
+}
+GPMG_PRELOAD_VISIBLE_ void operator delete(void* b,
+                                           const std::nothrow_t&) noexcept {
+    deallocate(b);
+}
+GPMG_PRELOAD_VISIBLE_ void operator delete[](void* b,
+                                             const std::nothrow_t&) noexcept {
+    deallocate(b);
+}
+GPMG_PRELOAD_VISIBLE_ void operator delete(void* b, std::size_t) noexcept {
+    deallocate(b);
+}
+GPMG_PRELOAD_VISIBLE_ void operator delete[](void* b, std::size_t) noexcept {
+    deallocate(b);
+}
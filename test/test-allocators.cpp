@@ -1,5 +1,12 @@
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #include "gpmg/allocators.hpp"
 #include "gpmg/misc.hpp"
 #include "gpmg/testing.hpp"
@@ -7,6 +14,17 @@
 using namespace std;
 using namespace gpmg;
 
+#ifdef GPMG_PROFILER_HAS_BACKTRACE_
+/// Allocates from a profiler in a frame of its own, reporting the address
+/// this frame returns to
+template <typename A>
+NO_INLINE void* allocateInOwnFrame(A& a, const size_t n,
+                                   void*& returnAddress) {
+    returnAddress = __builtin_return_address(0);
+    return a.allocate(n);
+}
+#endif
+
 int main(int argc, char* argv[]) {
     UNUSED(argc)
     UNUSED(argv)
@@ -42,6 +60,327 @@ int main(int argc, char* argv[]) {
 
     fallback.deallocate(fallback.allocate(1));
 
+    // Reallocation tests
+    void* moved = fallback.allocate(8);
+    CHECK(fallback.reallocate(moved, 8, 200) && !region.owns(moved),
+          "Testing fallback allocator moves a growing block to the fallback.")
+    fallback.deallocate(moved);
+
+    void* grown = region.allocate(4);
+    CHECK(region.expand(grown, 4, 8),
+          "Testing region allocator expands its most recent block in place.")
+
+    // Freelist tests
+    auto freelist = FreelistAllocator<MallocAllocator, 64>(mallocator);
+    void* cached = freelist.allocate(10);
+    freelist.deallocate(cached);
+    CHECK(freelist.allocate(64) == cached,
+          "Testing freelist allocator reuses a deallocated block.")
+    CHECK(freelist.allocate(65) == nullptr,
+          "Testing freelist allocator fails to allocate size > blockSize.")
+    freelist.deallocate(cached);
+    freelist.deallocateAll();
+
+    // Span tests
+    const size_t spanMemorySize = 64 * 4096;
+    auto spanMemory = malloc(spanMemorySize);
+    auto spans = SpanAllocator<4096>(spanMemory, spanMemorySize);
+    void* a = spans.allocate(4096);
+    void* b = spans.allocate(3 * 4096);
+    void* c = spans.allocate(4096);
+    CHECK(a && b && c && spans.owns(b),
+          "Testing span allocator allocates and owns page spans.")
+    spans.deallocate(b);
+    CHECK(!spans.owns(b),
+          "Testing span allocator no longer owns a deallocated span.")
+    CHECK(spans.allocate(2 * 4096) == b,
+          "Testing span allocator picks the best fitting free span.")
+    CHECK(spans.expand(b, 2 * 4096, 3 * 4096) &&
+              !spans.expand(b, 3 * 4096, 4 * 4096),
+          "Testing span allocator expands into a free right neighbour only.")
+    spans.deallocate(a);
+    spans.deallocate(c);
+    spans.deallocate(b);
+    void* whole = spans.allocate(60 * 4096);
+    CHECK(whole != nullptr,
+          "Testing span allocator coalesces neighbouring free spans.")
+    spans.deallocate(whole);
+
+    void* live[32] = {};
+    bool stressed = true;
+    srand(42);
+    for (int i = 0; i < 10000; ++i) {
+        const int slot = rand() % 32;
+        if (live[slot] != nullptr) {
+            stressed = stressed && spans.owns(live[slot]);
+            spans.deallocate(live[slot]);
+            live[slot] = nullptr;
+        } else {
+            live[slot] = spans.allocate((rand() % 4 + 1) * 4096 - 100);
+        }
+    }
+    for (void* p : live) {
+        if (p != nullptr) {
+            spans.deallocate(p);
+        }
+    }
+    CHECK(stressed && spans.allocate(60 * 4096) != nullptr,
+          "Testing span allocator recovers all pages after random use.")
+
+    // Locality tests
+    a = spans.allocate(4096);
+    b = spans.allocate(4096);
+    c = spans.allocate(4096);
+    spans.deallocate(b);
+    CHECK(spans.allocateNear(4096, a) == b,
+          "Testing span allocator allocates right after the hint's span.")
+    spans.deallocate(a);
+    CHECK(spans.allocateNear(4096, b) == a,
+          "Testing span allocator allocates right before the hint's span.")
+    spans.deallocate(a);
+    spans.deallocate(b);
+    spans.deallocate(c);
+    CHECK(allocateNear(mallocator, 8, nullptr) != nullptr,
+          "Testing allocateNear falls back to allocate without support.")
+    {
+        // Composites that can not tell which allocator a hint came from
+        // offer no allocateNear of their own
+        typedef FreelistAllocator<MallocAllocator, 64> Freelist;
+        auto unrouted = SegregatorAllocator<64, Freelist, MallocAllocator>(
+            Freelist(mallocator), mallocator);
+        auto unowned = FallbackAllocator<MallocAllocator, MallocAllocator>(
+            mallocator, mallocator);
+        void* hint = unrouted.allocate(8);
+        CHECK(allocateNear(unrouted, 8, hint) != nullptr &&
+                  allocateNear(unowned, 8, hint) != nullptr,
+              "Testing allocateNear falls back to allocate for composites "
+              "without ownership.")
+    }
+
+    // Zeroed allocation tests
+    auto filledWith = [](void* b, const size_t n, const int value) {
+        const unsigned char* p = static_cast<unsigned char*>(b);
+        return all_of(p, p + n, [=](unsigned char c) { return c == value; });
+    };
+    char dirtyMemory[64];
+    memset(dirtyMemory, 0xAB, sizeof(dirtyMemory));
+    auto dirtyRegion = RegionAllocator(dirtyMemory, 32);
+    auto cleanRegion = RegionAllocator(dirtyMemory + 32, 32, true);
+    CHECK(filledWith(dirtyRegion.allocateZeroed(16), 16, 0) &&
+              filledWith(cleanRegion.allocateZeroed(16), 16, 0xAB),
+          "Testing region allocator only clears regions not known zero.")
+
+    const size_t zeroMemorySize = 16 * 4096;
+    void* zeroMemory = malloc(zeroMemorySize);
+    memset(zeroMemory, 0xAB, zeroMemorySize);
+    auto zeroSpans = SpanAllocator<4096>(zeroMemory, zeroMemorySize, true);
+    void* used = zeroSpans.allocate(4096);
+    zeroSpans.deallocate(used);
+    char* zeroed = static_cast<char*>(zeroSpans.allocateZeroed(2 * 4096));
+    CHECK(zeroed == used && filledWith(zeroed, 4096, 0) &&
+              filledWith(zeroed + 4096, 4096, 0xAB),
+          "Testing span allocator only clears pages that were handed out.")
+    zeroSpans.deallocate(zeroed);
+    free(zeroMemory);
+
+#ifdef __linux__
+    void* mapped = mmap(nullptr, zeroMemorySize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    auto mappedSpans = SpanAllocator<4096>(mapped, zeroMemorySize, true);
+    used = mappedSpans.allocate(4 * 4096);
+    memset(used, 0xFF, 4 * 4096);
+    mappedSpans.deallocate(used);
+    CHECK(mappedSpans.purge() >= 4 * 4096 &&
+              filledWith(mappedSpans.allocateZeroed(4 * 4096), 4 * 4096, 0),
+          "Testing purged spans are handed out zeroed.")
+    munmap(mapped, zeroMemorySize);
+#endif
+
+    cached = freelist.allocate(64);
+    memset(cached, 0xFF, 64);
+    freelist.deallocate(cached);
+    CHECK(filledWith(freelist.allocateZeroed(64), 64, 0) &&
+              filledWith(allocateZeroed(mallocator, 100), 100, 0),
+          "Testing freelist and malloc allocators allocate zeroed blocks.")
+
+    // Segregator tests
+    auto segregator =
+        SegregatorAllocator<256, FreelistAllocator<MallocAllocator, 256>,
+                            SpanAllocator<4096>>(
+            FreelistAllocator<MallocAllocator, 256>(mallocator),
+            SpanAllocator<4096>(spanMemory, spanMemorySize));
+    void* small = segregator.allocate(100);
+    void* large = segregator.allocate(10000);
+    CHECK(small != nullptr && large != nullptr && segregator.allocate(100) &&
+              !spans.owns(small) && spans.owns(large),
+          "Testing segregator allocator splits allocations at the threshold.")
+    CHECK(segregator.reallocate(small, 100, 5000) && spans.owns(small),
+          "Testing segregator allocator moves a block across the threshold.")
+    segregator.deallocate(small);
+    segregator.deallocate(large);
+    CHECK(!spans.owns(large),
+          "Testing segregator allocator routes deallocation by ownership.")
+    large = segregator.allocate(4096);
+    void* nearLarge = segregator.allocateNear(4096, large);
+    CHECK(static_cast<char*>(nearLarge) - static_cast<char*>(large) == 4096,
+          "Testing segregator allocator routes allocateNear by ownership.")
+    segregator.deallocate(large);
+    segregator.deallocate(nearLarge);
+
+    // Adaptive segregator tests
+    {
+        typedef ThreadHeapAllocator<MallocAllocator, 1 << 16> ThreadHeap;
+        auto adaptive =
+            AdaptiveSegregatorAllocator<ThreadHeap, SpanAllocator<4096>, 4096>(
+                ThreadHeap(), spans, 64, 1, 64, 8);
+        void* early = adaptive.allocate(1000);
+        CHECK(spans.owns(early),
+              "Testing adaptive segregator starts at the given threshold.")
+        for (int i = 0; i < 64; ++i) {
+            adaptive.deallocate(adaptive.allocate(i % 4 == 0 ? 3000 : 1000));
+        }
+        void* late = adaptive.allocate(1000);
+        CHECK(adaptive.threshold() == 4096 && !spans.owns(late),
+              "Testing adaptive segregator raises the threshold to hot sizes.")
+        adaptive.deallocate(early);
+        adaptive.deallocate(late);
+        CHECK(!spans.owns(early),
+              "Testing adaptive segregator frees blocks from old thresholds.")
+
+        for (int i = 0; i < 64; ++i) {
+            adaptive.deallocate(adaptive.allocate(i % 32 == 0 ? 3000 : 100));
+        }
+        CHECK(adaptive.threshold() == 128,
+              "Testing adaptive segregator lowers the threshold past cold "
+              "sizes.")
+    }
+
+    {
+        typedef FreelistAllocator<MallocAllocator, 64> Freelist;
+        typedef AdaptiveSegregatorAllocator<Freelist, MallocAllocator, 64>
+            Unrouted;
+        auto unrouted = Unrouted(Freelist(mallocator), mallocator);
+        void* b = unrouted.allocate(8);
+        CHECK(b != nullptr && allocateNear(unrouted, 8, b) != nullptr &&
+                  !tools::hasMemberFunc_deallocate<Unrouted>::value &&
+                  !tools::hasMemberFunc_owns<Unrouted>::value,
+              "Testing adaptive segregator builds without ownership.")
+    }
+
+    // Sampling profiler tests
+    {
+        auto readBack = [](FILE* f, char* buffer, const size_t size) {
+            rewind(f);
+            buffer[fread(buffer, 1, size - 1, f)] = '\0';
+            fclose(f);
+        };
+        auto sparse = SamplingProfilerAllocator<MallocAllocator>(mallocator);
+        for (int i = 0; i < 100; ++i) {
+            sparse.deallocate(sparse.allocate(16));
+        }
+        CHECK(sparse.samples().empty(),
+              "Testing profiler samples nothing well within its period.")
+
+        auto profiler =
+            SamplingProfilerAllocator<MallocAllocator>(mallocator, 1);
+        void* dropped = profiler.allocate(64);
+        void* kept = profiler.allocate(128);
+        CHECK(profiler.samples().size() == 2 &&
+                  profiler.samples().find(kept)->size == 128,
+              "Testing profiler samples allocations larger than its period.")
+        profiler.deallocate(dropped);
+        CHECK(profiler.samples().size() == 1 &&
+                  !profiler.samples().contains(dropped),
+              "Testing profiler drops deallocated blocks from its table.")
+
+        char profile[1 << 16];
+        FILE* text = tmpfile();
+        CHECK(profiler.writeText(text), "Testing profiler writes text.")
+        readBack(text, profile, sizeof(profile));
+        CHECK(strstr(profile, "Live heap: 1 samples, ~128 bytes") != nullptr,
+              "Testing text profile totals the live samples.")
+        FILE* pprof = tmpfile();
+        CHECK(profiler.writePprof(pprof), "Testing profiler writes pprof.")
+        readBack(pprof, profile, sizeof(profile));
+        CHECK(strncmp(profile, "heap profile: 1: 128 [1: 128] @ heap_v2/1\n",
+                      42) == 0,
+              "Testing pprof profile starts with a heap_v2 header.")
+        profiler.deallocate(kept);
+
+#ifdef GPMG_PROFILER_HAS_BACKTRACE_
+        // The caller's frame comes first, directly followed by its caller
+        void* returnAddress = nullptr;
+        void* traced = allocateInOwnFrame(profiler, 64, returnAddress);
+        const auto* sample = profiler.samples().find(traced);
+        CHECK(sample != nullptr && sample->depth >= 2 &&
+                  sample->frames[1] == returnAddress,
+              "Testing profiler stacks start at the caller, not the "
+              "profiler.")
+        profiler.deallocate(traced);
+#endif
+    }
+
+    // Thread heap tests
+    {
+        typedef ThreadHeapAllocator<MallocAllocator, 1 << 16> ThreadHeap;
+        auto heap = ThreadHeap();
+        const size_t messageCount = 1000;
+        vector<void*> messages;
+        for (size_t i = 0; i < messageCount; ++i) {
+            messages.push_back(heap.allocate(48));
+        }
+        CHECK(find(messages.begin(), messages.end(), nullptr) == messages.end(),
+              "Testing thread heap allocator allocates small blocks.")
+        CHECK(heap.allocate(heap.goodSize(1 << 16)) == nullptr,
+              "Testing thread heap allocator fails to allocate large blocks.")
+
+        void* consumerBlock = nullptr;
+        thread consumer([&]() {
+            ThreadHeap consumerHeap;
+            for (void* m : messages) {
+                consumerHeap.deallocate(m);
+            }
+            consumerBlock = consumerHeap.allocate(48);
+            consumerHeap.deallocate(consumerBlock);
+        });
+        consumer.join();
+        CHECK(find(messages.begin(), messages.end(), consumerBlock) ==
+                  messages.end(),
+              "Testing remotely freed blocks are not reused by the freeing "
+              "thread.")
+
+        vector<void*> reused;
+        for (size_t i = 0; i < messageCount; ++i) {
+            reused.push_back(heap.allocate(48));
+        }
+        sort(messages.begin(), messages.end());
+        sort(reused.begin(), reused.end());
+        CHECK(messages == reused,
+              "Testing remotely freed blocks return to the owning thread.")
+
+        // Fill the segment and carry on into another, so that the lowest and
+        // highest blocks lie in different segments
+        for (size_t i = 0; i < messageCount; ++i) {
+            reused.push_back(heap.allocate(48));
+        }
+        sort(reused.begin(), reused.end());
+        heap.deallocate(reused[1]);
+        heap.deallocate(reused.back());
+        CHECK(heap.allocateNear(48, reused.front()) == reused[1],
+              "Testing thread heap allocates near the hint from its segment.")
+        reused.pop_back();
+        for (void* m : reused) {
+            heap.deallocate(m);
+        }
+
+        void* adopted = nullptr;
+        thread adopter([&]() { adopted = ThreadHeap().allocate(48); });
+        adopter.join();
+        CHECK(adopted == consumerBlock,
+              "Testing an exited thread's heap is adopted by a new thread.")
+    }
+
+    free(spanMemory);
     free(regionMemory);
     return FAILED_TEST_RESULTS();
 }
@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include "gpmg/allocators.hpp"
+#include "gpmg/containers.hpp"
+#include "gpmg/misc.hpp"
+#include "gpmg/testing.hpp"
+
+using namespace std;
+using namespace gpmg;
+
+/// A malloc backed allocator counting the blocks it hands out
+struct CountingAllocator {
+    void* allocate(size_t n) {
+        ++count;
+        return malloc(n);
+    }
+    void deallocate(void* b) { free(b); }
+
+    static size_t count;
+    unsigned int alignment = 16;
+};
+size_t CountingAllocator::count = 0;
+
+int main(int argc, char* argv[]) {
+    UNUSED(argc)
+    UNUSED(argv)
+
+    const size_t regionSize = 4096;
+    auto regionMemory = static_cast<char*>(malloc(regionSize));
+    auto mallocator = MallocAllocator();
+
+    // Vector tests
+    {
+        auto region = RegionAllocator(regionMemory, regionSize);
+        auto v = Vector<int, RegionAllocator>(region);
+        CHECK(v.pushBack(0), "Testing vector allocates its first element.")
+        const int* first = v.data();
+        bool pushed = true;
+        for (int i = 1; i < 100; ++i) {
+            pushed = pushed && v.pushBack(i);
+        }
+        CHECK(pushed, "Testing vector grows inside a region.")
+        CHECK(v.data() == first,
+              "Testing vector grows in place by expanding the region's top "
+              "block.")
+        CHECK(v.size() == 100 && v[99] == 99,
+              "Testing vector keeps its elements across growth.")
+        CHECK(!v.reserve(regionSize),
+              "Testing vector reports failure once the region is exhausted.")
+        CHECK(v.size() == 100 && v[0] == 0,
+              "Testing failed growth leaves the vector intact.")
+    }
+
+    {
+        // The region only guarantees byte alignment, so the characters leave
+        // its top misaligned for what follows
+        auto region = RegionAllocator(regionMemory, regionSize);
+        auto chars = Vector<char, RegionAllocator>(region);
+        chars.pushBack('a');
+        auto doubles = Vector<double, RegionAllocator>(chars.allocator());
+        bool pushed = true;
+        for (int i = 0; i < 20; ++i) {
+            pushed = pushed && doubles.pushBack(i * 0.5);
+        }
+        auto m = HashMap<int, double, RegionAllocator>(doubles.allocator());
+        CHECK(pushed && m.insert(1, 2.0) != nullptr && *m.find(1) == 2.0 &&
+                  doubles[19] == 9.5 &&
+                  reinterpret_cast<uintptr_t>(doubles.data()) %
+                          alignof(double) ==
+                      0,
+              "Testing containers align elements the allocator does not.")
+    }
+
+    {
+        auto v = Vector<long, MallocAllocator>(mallocator);
+        bool pushed = true;
+        for (long i = 0; i < 10000; ++i) {
+            pushed = pushed && v.pushBack(i);
+        }
+        long sum = 0;
+        for (long x : v) {
+            sum += x;
+        }
+        CHECK(pushed && sum == 10000L * 9999L / 2,
+              "Testing vector relocates trivially copyable elements through "
+              "the allocator's reallocate.")
+    }
+
+    {
+        auto v = Vector<string, MallocAllocator>(mallocator);
+        bool pushed = true;
+        for (int i = 0; i < 100; ++i) {
+            pushed = pushed && v.emplaceBack(to_string(i));
+        }
+        CHECK(pushed && v[42] == "42" && v.back() == "99",
+              "Testing vector moves non-trivially copyable elements on growth.")
+        CHECK(v.resize(10) && v.size() == 10,
+              "Testing vector shrinks when resized.")
+    }
+
+    {
+        // Neither side can tell its blocks apart, so the segregator can not
+        // route frees and the vector leaves its storage be
+        typedef SegregatorAllocator<64, FreelistAllocator<MallocAllocator, 64>,
+                                    MallocAllocator>
+            Unrouted;
+        auto v = Vector<int, Unrouted>(
+            Unrouted(FreelistAllocator<MallocAllocator, 64>(mallocator),
+                     mallocator));
+        bool pushed = true;
+        for (int i = 0; i < 100; ++i) {
+            pushed = pushed && v.pushBack(i);
+        }
+        CHECK(pushed && v[99] == 99 &&
+                  !tools::hasMemberFunc_deallocate<Unrouted>::value &&
+                  !tools::hasMemberFunc_owns<Unrouted>::value,
+              "Testing vector builds over a segregator without ownership.")
+    }
+
+    // Hash map tests
+    {
+        auto m = HashMap<int, int, MallocAllocator>(mallocator);
+        bool inserted = true;
+        for (int i = 0; i < 1000; ++i) {
+            inserted = inserted && m.insert(i, i * 2) != nullptr;
+        }
+        CHECK(inserted && m.size() == 1000,
+              "Testing hash map inserts many keys.")
+        CHECK(m.find(500) != nullptr && *m.find(500) == 1000,
+              "Testing hash map finds an inserted key.")
+        CHECK(m.find(1000) == nullptr,
+              "Testing hash map does not find an absent key.")
+
+        bool erased = true;
+        for (int i = 0; i < 1000; i += 2) {
+            erased = erased && m.erase(i);
+        }
+        bool consistent = m.size() == 500;
+        for (int i = 0; i < 1000; ++i) {
+            consistent = consistent && (m.contains(i) == (i % 2 == 1));
+        }
+        CHECK(erased && consistent,
+              "Testing hash map stays consistent after erasing keys.")
+
+        CHECK(*m.insert(1, 7) == 7 && m.size() == 500,
+              "Testing hash map replaces the value of an existing key.")
+    }
+
+    {
+        auto m = HashMap<int, int, CountingAllocator>(CountingAllocator());
+        bool inserted = true;
+        for (int i = 0; i < 10000; ++i) {
+            inserted = inserted && m.insert(i, i) != nullptr;
+        }
+        CHECK(inserted && CountingAllocator::count < 64,
+              "Testing hash map storage grows geometrically.")
+    }
+
+    {
+        // Page aligned addresses share their low bits, which an identity hash
+        // would leave crowding a few slots into one long probe sequence
+        const size_t keyCount = 50000;
+        auto m = HashMap<void*, size_t, MallocAllocator>(mallocator);
+        auto start = chrono::steady_clock::now();
+        bool found = true;
+        for (size_t i = 1; i <= keyCount; ++i) {
+            m.insert(reinterpret_cast<void*>(i * 4096), i);
+        }
+        for (size_t i = 1; i <= keyCount; ++i) {
+            const size_t* v = m.find(reinterpret_cast<void*>(i * 4096));
+            found = found && v != nullptr && *v == i;
+        }
+        auto elapsed = chrono::steady_clock::now() - start;
+        CHECK(found && m.size() == keyCount &&
+                  elapsed < chrono::milliseconds(250),
+              "Testing hash map spreads page aligned pointer keys.")
+    }
+
+    {
+        auto region = RegionAllocator(regionMemory, regionSize);
+        auto m = HashMap<string, int, RegionAllocator>(region);
+        CHECK(m.insert(string("one"), 1) != nullptr &&
+                  m.insert(string("two"), 2) != nullptr,
+              "Testing hash map allocates inside a region.")
+        CHECK(m.find("two") != nullptr && *m.find("two") == 2,
+              "Testing hash map finds a string key.")
+    }
+
+    free(regionMemory);
+    return FAILED_TEST_RESULTS();
+}
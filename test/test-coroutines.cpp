@@ -0,0 +1,151 @@
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "gpmg/allocators.hpp"
+#include "gpmg/coroutines.hpp"
+#include "gpmg/misc.hpp"
+#include "gpmg/testing.hpp"
+
+using namespace std;
+using namespace gpmg;
+
+/// A minimal lazily started coroutine, parameterised on its frame allocation
+template <typename Allocation>
+class Task {
+   public:
+    struct promise_type : Allocation {
+        Task get_return_object() {
+            return Task(coroutine_handle<promise_type>::from_promise(*this));
+        }
+        static Task get_return_object_on_allocation_failure() {
+            return Task(nullptr);
+        }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_always final_suspend() noexcept { return {}; }
+        void return_value(int v) { value = v; }
+        void unhandled_exception() { abort(); }
+
+        int value = 0;
+    };
+
+    explicit Task(coroutine_handle<promise_type> h) : handle_(h) {}
+    Task(const Task&) = delete;
+    Task(Task&& other) : handle_(other.handle_) { other.handle_ = nullptr; }
+    Task& operator=(const Task&) = delete;
+    Task& operator=(Task&&) = delete;
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool valid() const { return static_cast<bool>(handle_); }
+    void* frame() const { return handle_.address(); }
+    int run() {
+        handle_.resume();
+        return handle_.promise().value;
+    }
+
+   private:
+    coroutine_handle<promise_type> handle_;
+};
+
+/// A malloc backed allocator counting the blocks it has live
+struct LiveCountingAllocator {
+    void* allocate(size_t n) {
+        ++live;
+        return malloc(n);
+    }
+    void deallocate(void* b) {
+        --live;
+        free(b);
+    }
+
+    static atomic<int> live;
+    unsigned int alignment = 16;
+};
+atomic<int> LiveCountingAllocator::live(0);
+
+typedef Task<AllocatorArgPromise<RegionAllocator>> RegionTask;
+typedef FreelistAllocator<MallocAllocator, 512> Freelist;
+typedef Task<ThreadLocalAllocatorPromise<Freelist>> FreelistTask;
+typedef Task<ThreadLocalAllocatorPromise<
+    FreelistAllocator<LiveCountingAllocator, 512>>>
+    CountedTask;
+
+RegionTask addInRegion(allocator_arg_t, RegionAllocator&, int a, int b) {
+    co_return a + b;
+}
+
+FreelistTask addInFreelist(int a, int b) { co_return a + b; }
+
+CountedTask addCounted(int a, int b) { co_return a + b; }
+
+int main(int argc, char* argv[]) {
+    UNUSED(argc)
+    UNUSED(argv)
+
+    const size_t regionSize = 4096;
+    auto regionMemory = static_cast<char*>(malloc(regionSize));
+
+    // Allocator argument tests
+    {
+        auto region = RegionAllocator(regionMemory, regionSize);
+        auto task = addInRegion(allocator_arg, region, 2, 3);
+        CHECK(task.valid() && region.owns(task.frame()),
+              "Testing coroutine frame is allocated from the given region.")
+        CHECK(task.run() == 5,
+              "Testing coroutine allocated from a region runs correctly.")
+    }
+
+    {
+        auto region = RegionAllocator(regionMemory, regionSize);
+        region.allocate(1);
+        auto task = addInRegion(allocator_arg, region, 2, 3);
+        CHECK(task.valid() &&
+                  reinterpret_cast<uintptr_t>(task.frame()) %
+                          __STDCPP_DEFAULT_NEW_ALIGNMENT__ ==
+                      0,
+              "Testing coroutine frame is aligned after an odd sized "
+              "allocation.")
+        CHECK(task.run() == 5,
+              "Testing aligned coroutine frame runs correctly.")
+    }
+
+    {
+        auto region = RegionAllocator(regionMemory, 16);
+        auto task = addInRegion(allocator_arg, region, 2, 3);
+        CHECK(!task.valid(),
+              "Testing coroutine frame allocation failure is reported.")
+    }
+
+    // Thread local allocator tests
+    {
+        void* first = nullptr;
+        {
+            auto task = addInFreelist(4, 5);
+            first = task.frame();
+            CHECK(task.run() == 9,
+                  "Testing coroutine allocated from a freelist runs "
+                  "correctly.")
+        }
+        auto task = addInFreelist(1, 1);
+        CHECK(task.frame() == first,
+              "Testing coroutine frame is reused from the thread's freelist.")
+    }
+
+    {
+        int result = 0;
+        thread worker([&]() { result = addCounted(2, 2).run(); });
+        worker.join();
+        CHECK(result == 4 && LiveCountingAllocator::live == 0,
+              "Testing frames cached by an exited thread are released.")
+    }
+
+    free(regionMemory);
+    return FAILED_TEST_RESULTS();
+}
@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <malloc.h>
+#include <thread>
+#include <vector>
+#include "gpmg/misc.hpp"
+#include "gpmg/testing.hpp"
+
+using namespace std;
+
+// Run with the interposition library preloaded
+
+bool isAligned(void* b, const size_t alignment) {
+    return reinterpret_cast<uintptr_t>(b) % alignment == 0;
+}
+
+int main(int argc, char* argv[]) {
+    UNUSED(argc)
+    UNUSED(argv)
+
+    void* small = malloc(20);
+    CHECK(small != nullptr && malloc_usable_size(small) == 32,
+          "Testing malloc is interposed and rounds to a size class.")
+    free(small);
+
+    void* large = malloc(1 << 20);
+    CHECK(large != nullptr && malloc_usable_size(large) >= (1 << 20),
+          "Testing malloc serves large blocks.")
+    free(large);
+
+    auto grown = static_cast<char*>(malloc(16));
+    strcpy(grown, "gpmg");
+    grown = static_cast<char*>(realloc(grown, 100));
+    CHECK(grown != nullptr && strcmp(grown, "gpmg") == 0,
+          "Testing realloc within the small heaps keeps the contents.")
+    grown = static_cast<char*>(realloc(grown, 100000));
+    CHECK(grown != nullptr && strcmp(grown, "gpmg") == 0,
+          "Testing realloc across the threshold keeps the contents.")
+    free(grown);
+
+    auto zeroed = static_cast<unsigned char*>(calloc(64, 64));
+    bool allZero = zeroed != nullptr;
+    for (size_t i = 0; allZero && i < 64 * 64; ++i) {
+        allZero = zeroed[i] == 0;
+    }
+    CHECK(allZero, "Testing calloc returns zeroed memory.")
+    free(zeroed);
+
+    bool aligned = true;
+    for (size_t alignment = 8; alignment <= 8192; alignment *= 2) {
+        void* b = nullptr;
+        aligned = aligned && posix_memalign(&b, alignment, 24) == 0 &&
+                  isAligned(b, alignment);
+        free(b);
+        b = aligned_alloc(alignment, alignment * 2);
+        aligned = aligned && isAligned(b, alignment);
+        free(b);
+    }
+    CHECK(aligned, "Testing aligned allocation honours the alignment.")
+
+    auto object = new int(42);
+    auto array = new int[1000];
+    CHECK(*object == 42 && array != nullptr,
+          "Testing operator new is served by the composite.")
+    delete object;
+    delete[] array;
+
+    vector<void*> messages;
+    for (int i = 0; i < 10000; ++i) {
+        messages.push_back(malloc(i % 512 + 1));
+    }
+    thread consumer([&messages]() {
+        for (void* m : messages) {
+            free(m);
+        }
+    });
+    consumer.join();
+    CHECK(malloc(64) != nullptr,
+          "Testing blocks freed on another thread are handled.")
+
+    return FAILED_TEST_RESULTS();
+}